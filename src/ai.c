@@ -0,0 +1,446 @@
+#include "ai.h"
+#include "game_state.h"
+#include "topology.h"
+#include "bitboard.h"
+#include "time_utils.h"
+#include "macros.h"
+#include "log.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Follow-up moves played after the cascade of the move being scored
+#define AI_ROLLOUT_DEPTH 2
+
+// Random moves tried per follow-up before giving up on finding one that matches
+#define AI_PLY_ATTEMPTS 8
+
+// Guards against a board that never stops matching
+#define AI_MAX_CASCADES 50
+
+#define AI_AUTOPLAY_BUDGET_MS 20
+
+// Cursor keys for one move, plus the rotate key
+#define AI_AUTOPLAY_MAX_KEYS 32
+
+typedef struct {
+    pthread_t thread;
+    uint32_t id; // 0 is the thread calling ai_best_move()
+    Rng rng; // split from the others, so each worker has its own stream
+
+    // Per candidate, for the current search
+    double score_sum[MOVES_MAX];
+    uint32_t num_rollouts[MOVES_MAX];
+} AiWorker;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_cond_t job_ready;
+    pthread_cond_t job_done;
+    uint32_t job_id;
+    uint32_t num_active; // threads taking part in the current job, including the caller
+    uint32_t num_finished; // worker threads done with the current job
+    bool quit;
+
+    // Current job. Written before job_id is bumped, read-only while the job runs.
+    HexBoard board;
+    uint32_t level;
+    uint64_t deadline_ns;
+    Move candidates[MOVES_MAX];
+    size_t num_candidates;
+    uint32_t spawn_type_mask;
+
+    AiWorker workers[AI_MAX_THREADS];
+    uint32_t num_threads;
+} Ai;
+
+typedef enum {
+    AUTOPLAY_KEY_UP,
+    AUTOPLAY_KEY_DOWN,
+    AUTOPLAY_KEY_LEFT,
+    AUTOPLAY_KEY_RIGHT,
+    AUTOPLAY_KEY_ROTATE_CW,
+    AUTOPLAY_KEY_ROTATE_CCW,
+} AutoplayKey;
+
+typedef struct {
+    AutoplayKey keys[AI_AUTOPLAY_MAX_KEYS];
+    size_t num_keys;
+    size_t next_key;
+} Autoplay;
+
+static Ai _ai;
+static Autoplay _autoplay;
+
+// Remove the matched hexes, except flower centers, letting the hexes above fall into
+// their place and filling the top of the column with random hexes.
+static void remove_matched(HexBoard* board, const MoveOutcome* outcome, Rng* rng) {
+    const BitboardMask removed = outcome->matched & ~outcome->flower_centers;
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        // Bottom to top, moving survivors down over removed hexes
+        int dst = HEX_NUM_ROWS - 1;
+        for (int r = HEX_NUM_ROWS - 1; r >= 0; r--) {
+            const int index = HEX_INDEX(q, r);
+            if (!g_topology.is_valid[index]) {
+                dst--;
+                continue;
+            }
+            Hex* hex = &board->cells[index];
+            hex->is_matched = false;
+            hex->is_flower_matched = false;
+            if (!bitboard_test(removed, q, r)) {
+                board->cells[HEX_INDEX(q, dst--)] = *hex;
+            }
+        }
+        HexType types[HEX_NUM_ROWS];
+        hex_random_types(rng, _ai.spawn_type_mask, types, dst + 1);
+        for (; dst >= 0; dst--) {
+            board->cells[HEX_INDEX(q, dst)] = (Hex){
+                .type = types[dst],
+                .is_valid = true,
+                .is_stationary = true,
+            };
+        }
+    }
+}
+
+// Replaces matched hexes until the board comes to rest. Returns the score of the cascade,
+// including the matches already in outcome.
+static uint32_t cascade(HexBoard* board, MoveOutcome* outcome, Rng* rng) {
+    uint32_t score = outcome->score;
+    for (int i = 0; i < AI_MAX_CASCADES; i++) {
+        remove_matched(board, outcome, rng);
+        *outcome = (MoveOutcome){0};
+        if (!moves_resolve_matches(board, _ai.level, outcome)) {
+            break;
+        }
+        score += outcome->score;
+    }
+    return score;
+}
+
+// Play a random move that matches something, if one is found quickly
+static uint32_t random_ply(HexBoard* board, Rng* rng) {
+    Move moves[MOVES_MAX];
+    const size_t num_moves = moves_generate(board, moves, ARRAY_SIZE(moves));
+    for (int attempt = 0; attempt < AI_PLY_ATTEMPTS; attempt++) {
+        HexBoard scratch = *board;
+        MoveOutcome outcome;
+        if (moves_apply(&scratch, moves[rng_below(rng, num_moves)], _ai.level, &outcome)) {
+            *board = scratch;
+            return cascade(board, &outcome, rng);
+        }
+    }
+    return 0;
+}
+
+static uint32_t rollout(Move move, Rng* rng) {
+    HexBoard board = _ai.board;
+    MoveOutcome outcome;
+    if (!moves_apply(&board, move, _ai.level, &outcome)) {
+        return 0;
+    }
+    uint32_t score = cascade(&board, &outcome, rng);
+    for (int ply = 0; ply < AI_ROLLOUT_DEPTH; ply++) {
+        score += random_ply(&board, rng);
+    }
+    return score;
+}
+
+// Round-robin over the candidates until the deadline, each worker starting at a
+// different one.
+static void run_rollouts(AiWorker* worker) {
+    memset(worker->score_sum, 0, _ai.num_candidates * sizeof(worker->score_sum[0]));
+    memset(worker->num_rollouts, 0, _ai.num_candidates * sizeof(worker->num_rollouts[0]));
+
+    size_t candidate = worker->id % _ai.num_candidates;
+    while (now_ns() < _ai.deadline_ns) {
+        worker->score_sum[candidate] += rollout(_ai.candidates[candidate], &worker->rng);
+        worker->num_rollouts[candidate]++;
+        candidate = (candidate + 1) % _ai.num_candidates;
+    }
+}
+
+static void* worker_main(void* arg) {
+    AiWorker* worker = (AiWorker*)arg;
+    uint32_t seen_job_id = 0;
+
+    pthread_mutex_lock(&_ai.mutex);
+    while (1) {
+        while (!_ai.quit && _ai.job_id == seen_job_id) {
+            pthread_cond_wait(&_ai.job_ready, &_ai.mutex);
+        }
+        if (_ai.quit) {
+            break;
+        }
+        seen_job_id = _ai.job_id;
+        if (worker->id >= _ai.num_active) {
+            continue;
+        }
+
+        pthread_mutex_unlock(&_ai.mutex);
+        run_rollouts(worker);
+        pthread_mutex_lock(&_ai.mutex);
+
+        _ai.num_finished++;
+        pthread_cond_signal(&_ai.job_done);
+    }
+    pthread_mutex_unlock(&_ai.mutex);
+    return NULL;
+}
+
+bool ai_init(uint64_t seed) {
+    pthread_mutex_init(&_ai.mutex, NULL);
+    pthread_cond_init(&_ai.job_ready, NULL);
+    pthread_cond_init(&_ai.job_done, NULL);
+
+    const long num_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    const uint32_t max_threads = MIN((uint32_t)MAX(num_cpus, 1L), (uint32_t)AI_MAX_THREADS);
+    Rng rng;
+    rng_seed(&rng, seed);
+    // The first stream is the one a game seeded with seed draws from
+    rng_split(&rng);
+
+    _ai.workers[0] = (AiWorker){ .id = 0, .rng = rng_split(&rng) };
+    _ai.num_threads = 1;
+    for (uint32_t id = 1; id < max_threads; id++) {
+        AiWorker* worker = &_ai.workers[id];
+        *worker = (AiWorker){ .id = id, .rng = rng_split(&rng) };
+        if (pthread_create(&worker->thread, NULL, worker_main, worker) != 0) {
+            LOG("AI: failed to create worker thread %u", id);
+            break;
+        }
+        _ai.num_threads++;
+    }
+    LOG("AI: %u threads", _ai.num_threads);
+    return true;
+}
+
+void ai_close(void) {
+    pthread_mutex_lock(&_ai.mutex);
+    _ai.quit = true;
+    pthread_cond_broadcast(&_ai.job_ready);
+    pthread_mutex_unlock(&_ai.mutex);
+
+    for (uint32_t id = 1; id < _ai.num_threads; id++) {
+        pthread_join(_ai.workers[id].thread, NULL);
+    }
+    _ai.num_threads = 1;
+}
+
+uint32_t ai_num_threads(void) {
+    return _ai.num_threads;
+}
+
+bool ai_best_move(const HexBoard* board, uint32_t level, uint32_t budget_ms, uint32_t num_threads, AiResult* result) {
+    const uint64_t start = now_ns();
+    *result = (AiResult){0};
+
+    // Only moves that match something are worth rolling out
+    static MoveOutcome outcomes[MOVES_MAX];
+    const size_t num_moves = moves_evaluate_all(board, level, outcomes, MOVES_MAX);
+    _ai.num_candidates = 0;
+    const MoveOutcome* best_outcome = NULL;
+    for (size_t i = 0; i < num_moves; i++) {
+        if (outcomes[i].matched != 0) {
+            _ai.candidates[_ai.num_candidates++] = outcomes[i].move;
+            if (best_outcome == NULL || outcomes[i].score > best_outcome->score) {
+                best_outcome = &outcomes[i];
+            }
+        }
+    }
+    if (_ai.num_candidates == 0) {
+        return false;
+    }
+
+    _ai.board = *board;
+    _ai.level = level;
+    _ai.spawn_type_mask = hex_level_type_mask(level);
+    _ai.deadline_ns = start + (uint64_t)budget_ms * 1000000;
+
+    const uint32_t num_active = (num_threads == 0) ? _ai.num_threads : MIN(num_threads, _ai.num_threads);
+    pthread_mutex_lock(&_ai.mutex);
+    _ai.num_active = num_active;
+    _ai.num_finished = 0;
+    _ai.job_id++;
+    pthread_cond_broadcast(&_ai.job_ready);
+    pthread_mutex_unlock(&_ai.mutex);
+
+    run_rollouts(&_ai.workers[0]);
+
+    pthread_mutex_lock(&_ai.mutex);
+    while (_ai.num_finished < num_active - 1) {
+        pthread_cond_wait(&_ai.job_done, &_ai.mutex);
+    }
+    pthread_mutex_unlock(&_ai.mutex);
+
+    // Merge worker results and pick the best average
+    double best_score = -1.0;
+    for (size_t c = 0; c < _ai.num_candidates; c++) {
+        double score_sum = 0.0;
+        uint32_t num_rollouts = 0;
+        for (uint32_t id = 0; id < num_active; id++) {
+            score_sum += _ai.workers[id].score_sum[c];
+            num_rollouts += _ai.workers[id].num_rollouts[c];
+        }
+        result->num_rollouts += num_rollouts;
+        if (num_rollouts == 0) {
+            continue;
+        }
+        const double expected_score = score_sum / num_rollouts;
+        if (expected_score > best_score) {
+            best_score = expected_score;
+            result->move = _ai.candidates[c];
+            result->expected_score = expected_score;
+        }
+    }
+
+    // E.g. the thread was preempted past the deadline
+    if (best_score < 0.0) {
+        result->move = best_outcome->move;
+        result->expected_score = best_outcome->score;
+    }
+
+    result->found = true;
+    result->num_candidates = _ai.num_candidates;
+    result->num_threads = num_active;
+    result->elapsed_ns = now_ns() - start;
+    return result->found;
+}
+
+double ai_rollouts_per_sec_per_thread(const AiResult* result) {
+    if (result->elapsed_ns == 0 || result->num_threads == 0) {
+        return 0.0;
+    }
+    return (double)result->num_rollouts * 1e9 / (double)result->elapsed_ns / result->num_threads;
+}
+
+static int cursor_state_index(const Cursor* cursor) {
+    return HEX_INDEX(cursor->hex_anchor.q, cursor->hex_anchor.r) * 3 + cursor->position;
+}
+
+// Breadth-first search over cursor positions for the shortest key sequence that moves
+// the cursor onto the move. Returns false if the move can't be reached.
+static bool plan_cursor_keys(Game* game, const Cursor* start, Move move) {
+    if (!hex_coord_is_valid(start->hex_anchor)) {
+        return false;
+    }
+
+    typedef bool (*CursorMoveFn)(Game*, Cursor*);
+    static const CursorMoveFn move_fns[] = {
+        [AUTOPLAY_KEY_UP] = cursor_up,
+        [AUTOPLAY_KEY_DOWN] = cursor_down,
+        [AUTOPLAY_KEY_LEFT] = cursor_left,
+        [AUTOPLAY_KEY_RIGHT] = cursor_right,
+    };
+
+
+    Cursor queue[HEX_NUM_INDICES * 3];
+    int16_t parent[HEX_NUM_INDICES * 3];
+    int8_t parent_key[HEX_NUM_INDICES * 3];
+    memset(parent, -1, sizeof(parent));
+
+    size_t head = 0;
+    size_t tail = 0;
+    queue[tail++] = *start;
+    parent[cursor_state_index(start)] = cursor_state_index(start);
+
+    const Cursor target = { .hex_anchor = move.anchor, .position = move.position };
+    const int target_index = cursor_state_index(&target);
+    while (head < tail && parent[target_index] < 0) {
+        const Cursor cursor = queue[head++];
+        for (int key = 0; key < ARRAY_SIZE(move_fns); key++) {
+            Cursor next = cursor;
+            if (!move_fns[key](game, &next) || !hex_coord_is_valid(next.hex_anchor)) {
+                continue;
+            }
+            const int index = cursor_state_index(&next);
+            if (parent[index] >= 0) {
+                continue;
+            }
+            parent[index] = cursor_state_index(&cursor);
+            parent_key[index] = key;
+            queue[tail++] = next;
+        }
+    }
+    if (parent[target_index] < 0) {
+        return false;
+    }
+
+    // Walk back from the target, then reverse
+    size_t num_keys = 0;
+    for (int index = target_index; index != cursor_state_index(start); index = parent[index]) {
+        if (num_keys == AI_AUTOPLAY_MAX_KEYS - 1) {
+            return false;
+        }
+        _autoplay.keys[num_keys++] = parent_key[index];
+    }
+    for (size_t i = 0; i < num_keys / 2; i++) {
+        const AutoplayKey key = _autoplay.keys[i];
+        _autoplay.keys[i] = _autoplay.keys[num_keys - 1 - i];
+        _autoplay.keys[num_keys - 1 - i] = key;
+    }
+    _autoplay.keys[num_keys++] = move.clockwise ? AUTOPLAY_KEY_ROTATE_CW : AUTOPLAY_KEY_ROTATE_CCW;
+    _autoplay.num_keys = num_keys;
+    _autoplay.next_key = 0;
+    return true;
+}
+
+static void press_key(Input* input, AutoplayKey key) {
+    switch (key) {
+        case AUTOPLAY_KEY_UP: input->up = true; break;
+        case AUTOPLAY_KEY_DOWN: input->down = true; break;
+        case AUTOPLAY_KEY_LEFT: input->left = true; break;
+        case AUTOPLAY_KEY_RIGHT: input->right = true; break;
+        case AUTOPLAY_KEY_ROTATE_CW: input->rotate_cw = true; break;
+        case AUTOPLAY_KEY_ROTATE_CCW: input->rotate_ccw = true; break;
+    }
+}
+
+void ai_autoplay_update(GameState* state) {
+    Game* game = &state->game;
+    if (!state->autoplay) {
+        _autoplay.num_keys = 0;
+        return;
+    }
+
+    // The game drops key presses until the board is at rest
+    if (state->suspend_game ||
+        game->rotation_animation.in_progress ||
+        !hex_all_stationary_no_animation(game)) {
+        return;
+    }
+
+    if (_autoplay.next_key < _autoplay.num_keys) {
+        press_key(&state->input, _autoplay.keys[_autoplay.next_key++]);
+        return;
+    }
+
+    HexBoard board;
+    hex_board_from_game(&board, game);
+    AiResult result;
+    if (!ai_best_move(&board, game->level, AI_AUTOPLAY_BUDGET_MS, 0, &result)) {
+        // Only stop when nothing on the board matches
+        if (result.num_candidates == 0) {
+            LOG("Autoplay: no moves left");
+            state->autoplay = false;
+        }
+        return;
+    }
+    if (!plan_cursor_keys(game, &state->cursor, result.move)) {
+        LOG("Autoplay: can't reach (%d,%d)", result.move.anchor.q, result.move.anchor.r);
+        state->autoplay = false;
+        return;
+    }
+
+    LOG("Autoplay: (%d,%d) pos %d %s, expected score %.1f (%" PRIu64 " rollouts, %.0f per sec per thread)",
+            result.move.anchor.q,
+            result.move.anchor.r,
+            result.move.position,
+            result.move.clockwise ? "cw" : "ccw",
+            result.expected_score,
+            result.num_rollouts,
+            ai_rollouts_per_sec_per_thread(&result));
+    press_key(&state->input, _autoplay.keys[_autoplay.next_key++]);
+}
@@ -1,4 +1,5 @@
 #include "audio.h"
+#include "game.h"
 #include <SDL_mixer.h>
 #include <SDL.h>
 
@@ -66,6 +67,15 @@ void audio_play_sound_effect(AudioSoundEffect effect) {
     Mix_PlayChannel(AUDIO_ANY_CHANNEL, effect_to_mix_chunk(effect), AUDIO_ONE_SHOT);
 }
 
+void audio_update(Game* game) {
+    for (AudioSoundEffect effect = 0; effect < AUDIO_NUM_SOUND_EFFECTS; effect++) {
+        if (game->pending_sound_effects & (1 << effect)) {
+            audio_play_sound_effect(effect);
+        }
+    }
+    game->pending_sound_effects = 0;
+}
+
 void audio_play_pause_music(void) {
     if (!Mix_PlayingMusic()) {
         Mix_PlayMusic(_audio.music, AUDIO_LOOP);
@@ -0,0 +1,158 @@
+#include "benchmark.h"
+#include "game.h"
+#include "bitboard.h"
+#include "moves.h"
+#include "ai.h"
+#include "time_utils.h"
+#include "macros.h"
+#include "log.h"
+
+#define BENCHMARK_ITERATIONS 10000
+#define BENCHMARK_MOVES_ITERATIONS 1000
+#define BENCHMARK_AI_BUDGET_MS 250
+
+static double ns_per_has_any_matches(Game* game, MatchKernel kernel, bool* any_matches) {
+    bool any = false;
+    const uint64_t start = now_ns();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        any |= game_has_any_matches(game, kernel, true);
+    }
+    const uint64_t elapsed = now_ns() - start;
+    *any_matches = any;
+    return (double)elapsed / (double)BENCHMARK_ITERATIONS;
+}
+
+// Returns number of cells where the bitboard and reference kernels disagree
+static int cross_check_kernels(Game* game) {
+    Bitboard bitboard;
+    bitboard_from_board(&bitboard, game);
+    const BitboardMask trio_cells = bitboard_trio_cells(&bitboard, true);
+    const BitboardMask flower_centers = bitboard_flower_centers(&bitboard, true);
+
+    int mismatches = 0;
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        for (int r = 0; r < HEX_NUM_ROWS; r++) {
+            if (hex_has_cluster_match(game, q, r, NULL, NULL, true) != bitboard_test(trio_cells, q, r)) {
+                LOG("Trio mismatch at (%d,%d)", q, r);
+                mismatches++;
+            }
+            if (hex_has_flower_match(game, q, r, true) != bitboard_test(flower_centers, q, r)) {
+                LOG("Flower mismatch at (%d,%d)", q, r);
+                mismatches++;
+            }
+        }
+    }
+    return mismatches;
+}
+
+void benchmark_match_kernels(Game* game) {
+    LOG("Match kernel benchmark (%d iterations)", BENCHMARK_ITERATIONS);
+    for (MatchKernel kernel = 0; kernel < NUM_MATCH_KERNELS; kernel++) {
+        bool any_matches = false;
+        const double ns = ns_per_has_any_matches(game, kernel, &any_matches);
+        LOG("  %10s: %8.1f ns per board query (matches: %s)",
+                game_match_kernel_name(kernel),
+                ns,
+                any_matches ? "yes" : "no");
+    }
+    LOG("  cross-check mismatches: %d", cross_check_kernels(game));
+}
+
+void benchmark_moves(Game* game) {
+    HexBoard board;
+    hex_board_from_game(&board, game);
+
+    static MoveOutcome outcomes[MOVES_MAX];
+    size_t num_moves = 0;
+    const uint64_t start = now_ns();
+    for (int i = 0; i < BENCHMARK_MOVES_ITERATIONS; i++) {
+        num_moves = moves_evaluate_all(&board, game->level, outcomes, MOVES_MAX);
+    }
+    const uint64_t elapsed = now_ns() - start;
+
+    size_t num_scoring = 0;
+    uint32_t best_score = 0;
+    for (size_t i = 0; i < num_moves; i++) {
+        if (outcomes[i].score > 0) {
+            num_scoring++;
+        }
+        best_score = MAX(best_score, outcomes[i].score);
+    }
+
+    LOG("Move evaluation benchmark (%d iterations)", BENCHMARK_MOVES_ITERATIONS);
+    LOG("  %zu moves, %zu scoring, best score %u", num_moves, num_scoring, best_score);
+    LOG("  %8.1f us per board (all moves)", (double)elapsed / BENCHMARK_MOVES_ITERATIONS / 1000.0f);
+}
+
+void benchmark_moves_index(Game* game) {
+    HexBoard board;
+    hex_board_from_game(&board, game);
+    static MovesIndex index;
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < BENCHMARK_MOVES_ITERATIONS; i++) {
+        moves_index_reset(&index);
+        moves_index_update(&index, &board);
+    }
+    const uint64_t build_elapsed = now_ns() - start;
+    const uint32_t num_built = index.num_evaluated;
+
+    // Change one hex and change it back, as a rotation and its matches would
+    const int cell = HEX_INDEX(HEX_NUM_COLUMNS / 2, HEX_NUM_ROWS / 2);
+    HexBoard changed = board;
+    changed.cells[cell].type = (board.cells[cell].type == HEX_TYPE_GREEN) ? HEX_TYPE_BLUE : HEX_TYPE_GREEN;
+    uint64_t num_evaluated = 0;
+    start = now_ns();
+    for (int i = 0; i < BENCHMARK_MOVES_ITERATIONS; i++) {
+        moves_index_update(&index, (i % 2 == 0) ? &changed : &board);
+        num_evaluated += index.num_evaluated;
+    }
+    const uint64_t update_elapsed = now_ns() - start;
+
+    bool any = false;
+    Move move;
+    start = now_ns();
+    for (int i = 0; i < BENCHMARK_ITERATIONS; i++) {
+        any |= moves_index_first(&index, &move);
+    }
+    const uint64_t query_elapsed = now_ns() - start;
+
+    LOG("Moves index benchmark (%d iterations)", BENCHMARK_MOVES_ITERATIONS);
+    LOG("  %u matching moves", index.num_matching);
+    LOG("  %8.1f us per full build (%u moves)", (double)build_elapsed / BENCHMARK_MOVES_ITERATIONS / 1000.0f, num_built);
+    LOG("  %8.1f us per one hex update (%.0f moves)",
+            (double)update_elapsed / BENCHMARK_MOVES_ITERATIONS / 1000.0f,
+            (double)num_evaluated / BENCHMARK_MOVES_ITERATIONS);
+    LOG("  %8.1f ns per first matching move query (found: %s)",
+            (double)query_elapsed / BENCHMARK_ITERATIONS,
+            any ? "yes" : "no");
+}
+
+void benchmark_ai(Game* game) {
+    HexBoard board;
+    hex_board_from_game(&board, game);
+
+    LOG("AI rollout benchmark (%d ms per search)", BENCHMARK_AI_BUDGET_MS);
+    double single_thread_rate = 0.0;
+    for (uint32_t num_threads = 1; ; num_threads = MIN(num_threads * 2, ai_num_threads())) {
+        AiResult result;
+        if (!ai_best_move(&board, game->level, BENCHMARK_AI_BUDGET_MS, num_threads, &result)) {
+            LOG("  no matching moves on this board");
+            return;
+        }
+        const double rate = ai_rollouts_per_sec_per_thread(&result);
+        if (num_threads == 1) {
+            single_thread_rate = rate;
+        }
+        LOG("  %2u threads: %8.0f rollouts/sec/thread, %5.2fx speedup, best (%d,%d) expected score %.1f",
+                num_threads,
+                rate,
+                rate * num_threads / single_thread_rate,
+                result.move.anchor.q,
+                result.move.anchor.r,
+                result.expected_score);
+        if (num_threads == ai_num_threads()) {
+            break;
+        }
+    }
+}
@@ -0,0 +1,224 @@
+#include "bitboard.h"
+#include "hex.h"
+#include "macros.h"
+#include "log.h"
+#include <string.h>
+
+#define BIT(index) ((BitboardMask)1 << (index))
+
+// All cells in even/odd columns, excluding padding rows
+static BitboardMask _even_columns;
+static BitboardMask _odd_columns;
+
+bool bitboard_init(void) {
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        for (int r = 0; r < HEX_NUM_ROWS; r++) {
+            if (q & 1) {
+                _odd_columns |= BIT(HEX_INDEX(q, r));
+            } else {
+                _even_columns |= BIT(HEX_INDEX(q, r));
+            }
+        }
+    }
+    return true;
+}
+
+// Sets the bits of hex at bit, which must be clear
+static void set_cell(Bitboard* bitboard, BitboardMask bit, const Hex* hex) {
+    if (!hex->is_valid) {
+        return;
+    }
+    bitboard->valid |= bit;
+    if (hex->type >= 0 && hex->type < NUM_HEX_TYPES) {
+        bitboard->types[hex->type] |= bit;
+    }
+    if (hex->is_stationary) {
+        bitboard->stationary |= bit;
+    }
+    if (hex->is_matched) {
+        bitboard->matched |= bit;
+    }
+    if (hex->is_flower_matched) {
+        bitboard->flower_matched |= bit;
+    }
+}
+
+void bitboard_from_board(Bitboard* bitboard, Game* game) {
+    memset(bitboard, 0, sizeof(*bitboard));
+
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        for (int r = 0; r < HEX_NUM_ROWS; r++) {
+            set_cell(bitboard, BIT(HEX_INDEX(q, r)), hex_at(game, q, r));
+        }
+    }
+}
+
+void bitboard_update_cell(Bitboard* bitboard, Game* game, int q, int r) {
+    const BitboardMask bit = BIT(HEX_INDEX(q, r));
+    for (int type = 0; type < NUM_HEX_TYPES; type++) {
+        bitboard->types[type] &= ~bit;
+    }
+    bitboard->valid &= ~bit;
+    bitboard->stationary &= ~bit;
+    bitboard->matched &= ~bit;
+    bitboard->flower_matched &= ~bit;
+    set_cell(bitboard, bit, hex_at(game, q, r));
+}
+
+BitboardMask bitboard_neighbor_mask(BitboardMask mask, HexNeighborID neighbor_id) {
+    // The offset from a cell to its neighbor depends on column parity.
+    // Neighbors at a higher index are a right shift, lower index a left shift.
+    BitboardMask odd = 0;
+    BitboardMask even = 0;
+    switch (neighbor_id) {
+        case HEX_NEIGHBOR_TOP:
+            odd = even = mask << 1;
+            break;
+        case HEX_NEIGHBOR_TOP_RIGHT:
+            odd = mask >> (HEX_INDEX_STRIDE - 1);
+            even = mask >> HEX_INDEX_STRIDE;
+            break;
+        case HEX_NEIGHBOR_BOTTOM_RIGHT:
+            odd = mask >> HEX_INDEX_STRIDE;
+            even = mask >> (HEX_INDEX_STRIDE + 1);
+            break;
+        case HEX_NEIGHBOR_BOTTOM:
+            odd = even = mask >> 1;
+            break;
+        case HEX_NEIGHBOR_BOTTOM_LEFT:
+            odd = mask << HEX_INDEX_STRIDE;
+            even = mask << (HEX_INDEX_STRIDE - 1);
+            break;
+        case HEX_NEIGHBOR_TOP_LEFT:
+            odd = mask << (HEX_INDEX_STRIDE + 1);
+            even = mask << HEX_INDEX_STRIDE;
+            break;
+        default:
+            LOG("Invalid neighbor ID %d", neighbor_id);
+            ASSERT(false);
+            break;
+    }
+    return (odd & _odd_columns) | (even & _even_columns);
+}
+
+static BitboardMask matchable(const Bitboard* bitboard, bool require_stationary) {
+    BitboardMask mask = bitboard->valid & ~bitboard->matched;
+    if (require_stationary) {
+        mask &= bitboard->stationary;
+    }
+    return mask;
+}
+
+BitboardMask bitboard_trio_cells(const Bitboard* bitboard, bool require_stationary) {
+    const BitboardMask candidates = matchable(bitboard, require_stationary);
+    BitboardMask cells = 0;
+
+    for (int type = 0; type < NUM_HEX_TYPES; type++) {
+        const BitboardMask m = bitboard->types[type] & candidates;
+        if (!m) {
+            continue;
+        }
+
+        // Every trio has exactly one hex that is either to the left of the other two
+        // (cursor right of the hex) or to the right of the other two (cursor left of the hex).
+        const BitboardMask right_anchors = m &
+            bitboard_neighbor_mask(m, HEX_NEIGHBOR_TOP_RIGHT) &
+            bitboard_neighbor_mask(m, HEX_NEIGHBOR_BOTTOM_RIGHT);
+        const BitboardMask left_anchors = m &
+            bitboard_neighbor_mask(m, HEX_NEIGHBOR_BOTTOM_LEFT) &
+            bitboard_neighbor_mask(m, HEX_NEIGHBOR_TOP_LEFT);
+
+        // Expand anchors to the other two hexes of each trio
+        cells |= right_anchors;
+        cells |= bitboard_neighbor_mask(right_anchors, HEX_NEIGHBOR_BOTTOM_LEFT);
+        cells |= bitboard_neighbor_mask(right_anchors, HEX_NEIGHBOR_TOP_LEFT);
+        cells |= left_anchors;
+        cells |= bitboard_neighbor_mask(left_anchors, HEX_NEIGHBOR_TOP_RIGHT);
+        cells |= bitboard_neighbor_mask(left_anchors, HEX_NEIGHBOR_BOTTOM_RIGHT);
+    }
+    return cells;
+}
+
+BitboardMask bitboard_flower_centers(const Bitboard* bitboard, bool require_stationary) {
+    const BitboardMask centers = matchable(bitboard, require_stationary);
+
+    // Flower petals may already be matched with another flower
+    BitboardMask petals = bitboard->valid & (~bitboard->matched | bitboard->flower_matched);
+    if (require_stationary) {
+        petals &= bitboard->stationary;
+    }
+
+    BitboardMask flowers = 0;
+    for (int type = 0; type < NUM_HEX_TYPES; type++) {
+        const BitboardMask m = bitboard->types[type] & petals;
+        if (!m) {
+            continue;
+        }
+        BitboardMask all_neighbors = centers;
+        for (int id = 0; id < MAX_NUM_HEX_NEIGHBORS && all_neighbors; id++) {
+            all_neighbors &= bitboard_neighbor_mask(m, id);
+        }
+        flowers |= all_neighbors;
+    }
+    return flowers;
+}
+
+bool bitboard_has_any_matches(const Bitboard* bitboard, bool require_stationary) {
+    return
+        bitboard_trio_cells(bitboard, require_stationary) ||
+        bitboard_flower_centers(bitboard, require_stationary);
+}
+
+size_t bitboard_find_one_flower(const Bitboard* bitboard, BitboardMask centers, Vector hex_coords) {
+    const int index = bitboard_first(bitboard_flower_centers(bitboard, true) & centers);
+    if (index < 0) {
+        return 0;
+    }
+
+    const HexCoord c = hex_index_to_coord(index);
+    HexNeighbors neighbors = {0};
+    hex_neighbors(c.q, c.r, &neighbors, ALL_NEIGHBORS);
+    ASSERT(neighbors.num_neighbors == 6);
+
+    vector_push_back(hex_coords, &c);
+    for (int i = 0; i < 6; i++) {
+        vector_push_back(hex_coords, &neighbors.coords[i]);
+    }
+    return 7;
+}
+
+bool bitboard_test(BitboardMask mask, int q, int r) {
+    return (mask & BIT(HEX_INDEX(q, r))) != 0;
+}
+
+void bitboard_set(BitboardMask* mask, int q, int r) {
+    *mask |= BIT(HEX_INDEX(q, r));
+}
+
+BitboardMask bitboard_all_cells(void) {
+    return _even_columns | _odd_columns;
+}
+
+BitboardMask bitboard_dilate(BitboardMask mask) {
+    BitboardMask dilated = mask;
+    for (int id = 0; id < MAX_NUM_HEX_NEIGHBORS; id++) {
+        dilated |= bitboard_neighbor_mask(mask, id);
+    }
+    return dilated;
+}
+
+int bitboard_count(BitboardMask mask) {
+    return __builtin_popcountll((uint64_t)mask) + __builtin_popcountll((uint64_t)(mask >> 64));
+}
+
+int bitboard_first(BitboardMask mask) {
+    const uint64_t low = (uint64_t)mask;
+    const uint64_t high = (uint64_t)(mask >> 64);
+    if (low) {
+        return __builtin_ctzll(low);
+    }
+    if (high) {
+        return 64 + __builtin_ctzll(high);
+    }
+    return -1;
+}
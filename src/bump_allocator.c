@@ -21,54 +21,55 @@
 
 #include "bump_allocator.h"
 
-#include <stdint.h>
 #include <string.h>
 #include <macros.h>
 
-static struct {
-    uint8_t* buffer;
-    size_t buffer_size;
-    size_t offset;
-    size_t num_allocations;
-} _bump_allocator;
-
-void bump_allocator_init(void* backing_buffer, size_t backing_buffer_size) {
-    _bump_allocator.buffer = (uint8_t*)backing_buffer;
-    _bump_allocator.buffer_size = backing_buffer_size;
-    _bump_allocator.offset = 0;
+void bump_allocator_init(BumpAllocator* allocator, void* backing_buffer, size_t backing_buffer_size) {
+    allocator->buffer = (uint8_t*)backing_buffer;
+    allocator->buffer_size = backing_buffer_size;
+    allocator->offset = 0;
+    allocator->num_allocations = 0;
 }
 
-void* bump_allocator_alloc(size_t size) {
+void* bump_allocator_alloc(BumpAllocator* allocator, size_t size) {
     void* ptr = NULL;
 
-    size_t space_remaining = _bump_allocator.buffer_size - _bump_allocator.offset;
+    size_t space_remaining = allocator->buffer_size - allocator->offset;
     if (size > space_remaining) {
         ASSERT(false && "Allocation failed, not enough space in backing buffer");
         return NULL;
     }
 
-    ptr = &_bump_allocator.buffer[_bump_allocator.offset];
-    _bump_allocator.offset += size;
-    _bump_allocator.num_allocations++;
+    ptr = &allocator->buffer[allocator->offset];
+    allocator->offset += size;
+    allocator->num_allocations++;
 
     memset(ptr, 0, size);
     return ptr;
 }
 
-void bump_allocator_free(void* ptr) {
+void bump_allocator_free(BumpAllocator* allocator, void* ptr) {
     // Do nothing
     return;
 }
 
-void bump_allocator_free_all(void) {
-    _bump_allocator.offset = 0;
-    _bump_allocator.num_allocations = 0;
+void bump_allocator_free_all(BumpAllocator* allocator) {
+    allocator->offset = 0;
+    allocator->num_allocations = 0;
+}
+
+void bump_allocator_deinit(BumpAllocator* allocator) {
+    memset(allocator, 0, sizeof(*allocator));
+}
+
+size_t bump_allocator_num_allocations(const BumpAllocator* allocator) {
+    return allocator->num_allocations;
 }
 
-void bump_allocator_deinit(void) {
-    memset(&_bump_allocator, 0, sizeof(_bump_allocator));
+void* bump_allocator_vector_alloc(void* allocator, size_t size) {
+    return bump_allocator_alloc((BumpAllocator*)allocator, size);
 }
 
-size_t bump_allocator_num_allocations(void) {
-    return _bump_allocator.num_allocations;
+void bump_allocator_vector_free(void* allocator, void* ptr) {
+    bump_allocator_free((BumpAllocator*)allocator, ptr);
 }
@@ -1,6 +1,6 @@
 #include "constants.h"
 #include "hex.h"
-#include "window.h"
+#include <math.h>
 
 Constants g_constants = {0};
 
@@ -1,10 +1,11 @@
 #include "cursor.h"
 #include "hex.h"
-#include "game_state.h"
+#include "game.h"
+#include "log.h"
 #include <macros.h>
 
-static Hex* anchor(const Cursor* cursor) {
-    return hex_at(cursor->hex_anchor.q, cursor->hex_anchor.r);
+static Hex* anchor(Game* game, const Cursor* cursor) {
+    return hex_at(game, cursor->hex_anchor.q, cursor->hex_anchor.r);
 }
 
 static void update_screen_point(Cursor* cursor) {
@@ -28,7 +29,13 @@ void cursor_init(Cursor* cursor) {
     update_screen_point(cursor);
 }
 
-bool cursor_up(Cursor* cursor) {
+void cursor_set(Cursor* cursor, HexCoord anchor, CursorPos position) {
+    cursor->hex_anchor = anchor;
+    cursor->position = position;
+    update_screen_point(cursor);
+}
+
+bool cursor_up(Game* game, Cursor* cursor) {
     int q = cursor->hex_anchor.q;
     int r = cursor->hex_anchor.r;
 
@@ -38,22 +45,19 @@ bool cursor_up(Cursor* cursor) {
         }
         cursor->hex_anchor = hex_neighbor_coord(q, r, HEX_NEIGHBOR_TOP_RIGHT);
         cursor->position = CURSOR_POS_LEFT;
-    } else if (cursor->position == CURSOR_POS_LEFT) {
+    } else if (cursor->position == CURSOR_POS_LEFT || cursor->position == CURSOR_POS_ON) {
         if (r == 0) {
             return false;
         }
         cursor->hex_anchor = hex_neighbor_coord(q, r, HEX_NEIGHBOR_TOP_LEFT);
         cursor->position = CURSOR_POS_RIGHT;
-    } else if (cursor->position == CURSOR_POS_ON) {
-        cursor->hex_anchor = hex_neighbor_coord(q, r, HEX_NEIGHBOR_TOP_LEFT);
-        cursor->position = CURSOR_POS_RIGHT;
     }
 
     update_screen_point(cursor);
     return true;
 }
 
-bool cursor_down(Cursor* cursor) {
+bool cursor_down(Game* game, Cursor* cursor) {
     int q = cursor->hex_anchor.q;
     int r = cursor->hex_anchor.r;
 
@@ -63,29 +67,29 @@ bool cursor_down(Cursor* cursor) {
         }
         cursor->hex_anchor = hex_neighbor_coord(q, r, HEX_NEIGHBOR_BOTTOM_RIGHT);
         cursor->position = CURSOR_POS_LEFT;
-    } else if (cursor->position == CURSOR_POS_LEFT) {
-        if (r == HEX_NUM_ROWS - 1) {
+    } else if (cursor->position == CURSOR_POS_LEFT || cursor->position == CURSOR_POS_ON) {
+        // The bottom row of even columns is invalid, so the trio below the last
+        // valid row of an even column would include it
+        bool q_even = ((q & 1) == 0);
+        if ((r == HEX_NUM_ROWS - 1) || (q_even && r == HEX_NUM_ROWS - 2)) {
             return false;
         }
         cursor->hex_anchor = hex_neighbor_coord(q, r, HEX_NEIGHBOR_BOTTOM_LEFT);
         cursor->position = CURSOR_POS_RIGHT;
-    } else if (cursor->position == CURSOR_POS_ON) {
-        cursor->hex_anchor = hex_neighbor_coord(q, r, HEX_NEIGHBOR_BOTTOM_LEFT);
-        cursor->position = CURSOR_POS_RIGHT;
     }
 
     update_screen_point(cursor);
     return true;
 }
 
-bool cursor_left(Cursor* cursor) {
+bool cursor_left(Game* game, Cursor* cursor) {
     int q = cursor->hex_anchor.q;
 
     if (cursor->position == CURSOR_POS_RIGHT) {
         if (q == 0) {
             return false;
         }
-        HexType type = anchor(cursor)->type;
+        HexType type = anchor(game, cursor)->type;
         if ((type == HEX_TYPE_STARFLOWER) ||
             (type == HEX_TYPE_BLACK_PEARL_UP) ||
             (type == HEX_TYPE_BLACK_PEARL_DOWN)) {
@@ -107,7 +111,7 @@ bool cursor_left(Cursor* cursor) {
     return true;
 }
 
-bool cursor_right(Cursor* cursor) {
+bool cursor_right(Game* game, Cursor* cursor) {
     int q = cursor->hex_anchor.q;
 
     if (cursor->position == CURSOR_POS_RIGHT) {
@@ -120,7 +124,7 @@ bool cursor_right(Cursor* cursor) {
         if (q >= HEX_NUM_COLUMNS - 1) {
             return false;
         }
-        HexType type = anchor(cursor)->type;
+        HexType type = anchor(game, cursor)->type;
         if ((type == HEX_TYPE_STARFLOWER) ||
             (type == HEX_TYPE_BLACK_PEARL_UP) ||
             (type == HEX_TYPE_BLACK_PEARL_DOWN)) {
@@ -136,12 +140,12 @@ bool cursor_right(Cursor* cursor) {
     return true;
 }
 
-void cursor_neighbors(const Cursor* cursor, HexNeighbors* neighbors) {
+void cursor_neighbors(Game* game, const Cursor* cursor, HexNeighbors* neighbors) {
     const int q = cursor->hex_anchor.q;
     const int r = cursor->hex_anchor.r;
 
     if (cursor->position == CURSOR_POS_ON) {
-        const HexType type = anchor(cursor)->type;
+        const HexType type = anchor(game, cursor)->type;
         if (type == HEX_TYPE_STARFLOWER) {
             hex_neighbors(q, r, neighbors, ALL_NEIGHBORS);
         } else if (type == HEX_TYPE_BLACK_PEARL_UP) {
@@ -158,35 +162,35 @@ void cursor_neighbors(const Cursor* cursor, HexNeighbors* neighbors) {
     }
 }
 
-void cursor_print(void) {
+void cursor_print(const Cursor* cursor) {
     const char* pos_str = "";
-    if (g_state.cursor.position == CURSOR_POS_LEFT) {
+    if (cursor->position == CURSOR_POS_LEFT) {
         pos_str = "Left of";
-    } else if (g_state.cursor.position == CURSOR_POS_RIGHT) {
+    } else if (cursor->position == CURSOR_POS_RIGHT) {
         pos_str = "Right of";
-    } else if (g_state.cursor.position == CURSOR_POS_ON) {
+    } else if (cursor->position == CURSOR_POS_ON) {
         pos_str = "On";
     } else {
         pos_str = "Unknown";
     }
 
-    SDL_Log("Cursor %s (%d,%d)",
+    LOG("Cursor %s (%d,%d)",
             pos_str,
-            g_state.cursor.hex_anchor.q,
-            g_state.cursor.hex_anchor.r);
+            cursor->hex_anchor.q,
+            cursor->hex_anchor.r);
 }
 
-bool cursor_contains_hex(const Cursor* cursor, HexCoord query_hex_coord) {
-    const Hex* query_hex = hex_at(query_hex_coord.q, query_hex_coord.r);
-    if (query_hex == anchor(cursor)) {
+bool cursor_contains_hex(Game* game, const Cursor* cursor, HexCoord query_hex_coord) {
+    const Hex* query_hex = hex_at(game, query_hex_coord.q, query_hex_coord.r);
+    if (query_hex == anchor(game, cursor)) {
         return true;
     }
 
     HexNeighbors cursor_hexes = {0};
-    cursor_neighbors(cursor, &cursor_hexes);
+    cursor_neighbors(game, cursor, &cursor_hexes);
 
     for (int i = 0; i < cursor_hexes.num_neighbors; i++) {
-        const Hex* n = hex_at(cursor_hexes.coords[i].q, cursor_hexes.coords[i].r);
+        const Hex* n = hex_at(game, cursor_hexes.coords[i].q, cursor_hexes.coords[i].r);
         if (n == query_hex) {
             return true;
         }
@@ -1,15 +1,17 @@
 #include "game_state.h"
-#include "window.h"
+#include "log.h"
 #include "hex.h"
 #include "macros.h"
 #include "time_utils.h"
 #include "bump_allocator.h"
-#include "text.h"
 #include "test_boards.h"
 #include "macros.h"
-#include "audio.h"
+#include "bitboard.h"
+#include "benchmark.h"
 #include <stdlib.h>
+#include <stdio.h>
 #include <inttypes.h>
+#include <string.h>
 
 #define ROTATION_TIME_MS 150
 #define ROTATION_MAX_SCALE 1.5f
@@ -20,186 +22,228 @@
 #define CLUSTER_MATCH_ANIMATION_TIME_MS 500
 #define GRAVITY_INITIAL 10.0f
 #define GRAVITY_NORMAL 0.5f
-#define MAX_VELOCITY 50
 #define HEX_GRAVITY_DELAY_MS 200
+#define RESHUFFLE_MAX_ATTEMPTS 100
 
-// Convenience accessors to global state
-static Game* game = &g_state.game;
+// Thread-local so that an ASSERT() reports the game that failed it
+static _Thread_local GameState* _current_state = NULL;
+static _Thread_local bool _in_assert = false;
 
-static bool board_has_any_matches(bool require_stationary) {
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            if (hex_has_cluster_match(q, r, NULL, NULL, require_stationary)) {
-                return true;
-            }
-            if (hex_has_flower_match(q, r, require_stationary)) {
-                return true;
-            }
-        }
-    }
-    return false;
+static bool board_has_any_matches(GameState* state, bool require_stationary) {
+    return game_has_any_matches(&state->game, state->match_kernel, require_stationary);
 }
 
-static void hex_coord_print(const void* vector_item, char* buffer, size_t buffer_size) {
-    HexCoord coord = *(const HexCoord*)vector_item;
-    snprintf(buffer, buffer_size, "(q, r) = (%d, %d)", coord.q, coord.r);
+static void mark_dirty(Game* game, int q, int r) {
+    bitboard_set(&game->dirty_cells, q, r);
 }
 
-static bool local_score_animation_in_progress(const void* vector_item) {
-    const LocalScoreAnimation* lsa = (const LocalScoreAnimation*)vector_item;
-    return !lsa->in_progress;
+static void set_match_animation(Game* game, HexAnimation* animation, HexMatchAnimation match_animation) {
+    if (animation->match_animation == HEX_MATCH_ANIMATION_NONE) {
+        game->num_animating_hexes++;
+    }
+    if (match_animation == HEX_MATCH_ANIMATION_NONE) {
+        game->num_animating_hexes--;
+    }
+    animation->match_animation = match_animation;
 }
 
-static bool hex_is_dead(const void* vector_item) {
-    const Hex* hex = (const Hex*)vector_item;
-    return hex->is_dead;
+static void play_sound_effect(Game* game, AudioSoundEffect effect) {
+    game->pending_sound_effects |= (1 << effect);
 }
 
-static void handle_flower_match_animations(void) {
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        int respawn_count = 0;
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            Hex* hex = hex_at(q, r);
-            FlowerMatchAnimation* fma = &hex->flower_match_animation;
-            if (!fma->in_progress) {
-                continue;
-            }
+static void hex_coord_print(const void* vector_item, char* buffer, size_t buffer_size) {
+    HexCoord coord = *(const HexCoord*)vector_item;
+    snprintf(buffer, buffer_size, "(q, r) = (%d, %d)", coord.q, coord.r);
+}
 
-            const double animation_progress =
-                (double)(g_state.frame_count - fma->start_time) /
-                (double)ms_to_frames(FLOWER_MATCH_ANIMATION_TIME_MS);
-
-            if (animation_progress > 1.0f) {
-                fma->in_progress = false;
-                hex->is_matched = false;
-                hex->is_flower_matched = false;
-                if (!fma->is_center) {
-                    // Respawn the perimeter of the flower
-                    hex->is_dead = true;
-                    respawn_count++;
-                }
-            } else {
-                if (!fma->is_center) {
-                    { // compute alpha
-                        double s0 = 1.0f;
-                        double s1 = 0.0f;
-                        double t = animation_progress;
-                        t = t * t; // ease in, smash out
-                        hex->alpha = (1.0f - t) * s0 + t * s1;
-                    }
-
-                    { // compute scale
-                        double s0 = 1.0f;
-                        double s1 = FLOWER_MATCH_MAX_SCALE;
-                        double t = animation_progress;
-                        hex->scale = (1.0f - t) * s0 + t * s1;
-                    }
-                }
-            }
+// Worst case, every hex is in a match animation with a tween for its alpha and scale, the
+// largest rotation is running and every local score animation is shown
+_Static_assert(TWEEN_POOL_SIZE >=
+        2 * HEX_NUM_COLUMNS * HEX_NUM_ROWS + 2 * (MAX_NUM_HEX_NEIGHBORS + 1) + 2 * MAX_LOCAL_SCORE_ANIMATIONS,
+        "tween pool can run out");
+
+// Sets the hexes of column q from stack index first up falling to their place on the
+// board. Each starts no closer than a hex height above the hex below it, which started
+// falling no later and so stays ahead until it lands.
+static void schedule_falls(Game* game, int q, int first) {
+    Hex* hexes = hex_column(game, q);
+    HexMotion* motions = hex_motion_column(game, q);
+    for (int i = first; i < (int)game->columns[q].size; i++) {
+        if (!hexes[i].is_valid) {
+            continue;
         }
-
-        vector_erase_if(g_state.game.hexes[q], hex_is_dead);
-
-        // Respawn dead hexes
-        uint32_t now = g_state.frame_count;
-        for (int i = 0; i < respawn_count; i++) {
-            const Hex* stack_top = hex_at(q, hex_stack_index_to_row(vector_size(g_state.game.hexes[q]) - 1));
-            Hex* new_hex = hex_spawn(q);
-
-            // Start gravity after a short delay, making sure to start gravity
-            // after the hex below.
-            uint32_t gravity_start_base = (i == 0) ?
-                MAX(now, stack_top->gravity_start_time) :
-                stack_top->gravity_start_time;
-            new_hex->gravity_start_time = gravity_start_base + ms_to_frames(HEX_GRAVITY_DELAY_MS);
+        HexMotion* motion = &motions[i];
+        const int r = hex_stack_index_to_row(i);
+        motion->gravity = game->gravity;
+        if (hexes[i].is_stationary) {
+            hexes[i].is_stationary = false;
+            game->num_falling_hexes++;
         }
+        if (i > 0) {
+            const Point below = hex_position(game, q, hex_stack_index_to_row(i - 1), motion->gravity_start_time);
+            motion->fall_start_y = MIN(motion->fall_start_y, below.y - HEX_HEIGHT);
+        }
+        const double distance = transform_hex_to_screen(q, r).y - motion->fall_start_y;
+        motion->landing_time = motion->gravity_start_time + hex_fall_frames(motion->gravity, distance) - 1;
+        game->falling_columns |= 1u << q;
+        game->next_landing_time = MIN(game->next_landing_time, motion->landing_time);
     }
 }
 
-static void handle_cluster_match_animations(void) {
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        int respawn_count = 0;
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            Hex* hex = hex_at(q, r);
-            ClusterMatchAnimation* cma = &hex->cluster_match_animation;
-            if (!cma->in_progress) {
-                continue;
-            }
-
-            const double animation_progress =
-                (double)(g_state.frame_count - cma->start_time) /
-                (double)ms_to_frames(CLUSTER_MATCH_ANIMATION_TIME_MS);
-
-            if (animation_progress > 1.0f) {
-                cma->in_progress = false;
-                hex->is_dead = true;
-                respawn_count++;
-            } else {
-                double s0 = 1.0f;
-                double s1 = 0.0f;
-                double t = animation_progress;
-                hex->scale = (1.0f - t) * s0 + t * s1;
-            }
+// Erases the hexes at the stack indices in the dead mask from column q. The hexes above
+// fall into their place, and new hexes are spawned above the column to replace them.
+static void respawn_hexes(GameState* state, int q, uint32_t dead) {
+    Game* game = &state->game;
+    uint32_t now = state->frame_count;
+    Hex* hexes = hex_column(game, q);
+    HexMotion* motions = hex_motion_column(game, q);
+
+    // Where the survivors are now, in their new stack order
+    float start_y[HEX_NUM_ROWS];
+    int num_survivors = 0;
+    for (int i = 0; i < (int)game->columns[q].size; i++) {
+        if (dead & (1u << i)) {
+            hexes[i].is_dead = true;
+        } else {
+            start_y[num_survivors++] = hex_position(game, q, hex_stack_index_to_row(i), now).y;
         }
+    }
+    hex_erase_dead(game, q);
+    tween_pool_erase(&game->tweens, q, dead);
+
+    // Hexes above the first dead one fall from where they are, starting from rest
+    const int first = __builtin_ctz(dead);
+    for (int i = first; i < num_survivors; i++) {
+        if (motions[i].gravity_start_time <= now) {
+            motions[i].fall_start_y = start_y[i];
+            motions[i].gravity_start_time = now;
+        }
+    }
 
-        vector_erase_if(g_state.game.hexes[q], hex_is_dead);
-
-        // Respawn dead hexes
-        uint32_t now = g_state.frame_count;
-        for (int i = 0; i < respawn_count; i++) {
-            const Hex* stack_top = hex_at(q, hex_stack_index_to_row(vector_size(g_state.game.hexes[q]) - 1));
-            Hex* new_hex = hex_spawn(q);
+    const int respawn_count = __builtin_popcount(dead);
+    HexType types[HEX_NUM_ROWS];
+    hex_random_types(&game->rng, hex_level_type_mask(game->level), types, respawn_count);
+    for (int i = 0; i < respawn_count; i++) {
+        const HexMotion* stack_top = hex_motion_at(game, q, hex_stack_index_to_row(game->columns[q].size - 1));
+        const int new_row = hex_spawn(game, q, types[i]);
+
+        // Start gravity after a short delay, making sure to start gravity
+        // after the hex below.
+        uint32_t gravity_start_base = (i == 0) ?
+            MAX(now, stack_top->gravity_start_time) :
+            stack_top->gravity_start_time;
+        hex_motion_at(game, q, new_row)->gravity_start_time = gravity_start_base + ms_to_frames(HEX_GRAVITY_DELAY_MS);
+    }
+    schedule_falls(game, q, first);
+}
 
-            // Start gravity after a short delay, making sure to start gravity
-            // after the hex below.
-            uint32_t gravity_start_base = (i == 0) ?
-                MAX(now, stack_top->gravity_start_time) :
-                stack_top->gravity_start_time;
-            new_hex->gravity_start_time = gravity_start_base + ms_to_frames(HEX_GRAVITY_DELAY_MS);
+// Moves the stack indices in mask to where their hexes are once the hexes at the stack
+// indices in erased have been erased from the column
+static uint32_t mask_after_erase(uint32_t mask, uint32_t erased) {
+    uint32_t result = 0;
+    for (int i = 0; i < HEX_NUM_ROWS; i++) {
+        if ((mask & (1u << i)) && !(erased & (1u << i))) {
+            result |= 1u << (i - __builtin_popcount(erased & ((1u << i) - 1)));
         }
     }
+    return result;
 }
 
-static void handle_local_score_animations(void) {
-    for (size_t i = 0; i < vector_size(game->local_score_animations); i++) {
-        LocalScoreAnimation* lsa = (LocalScoreAnimation*)
-            vector_data_at(game->local_score_animations, i);
+// Advances every running animation, then acts on the match animations that finished
+static void handle_animations(GameState* state) {
+    Game* game = &state->game;
+    if (game->tweens.size == 0) {
+        return;
+    }
 
-        const double animation_progress =
-            (double)(g_state.frame_count - lsa->start_time) /
-            (double)ms_to_frames(LOCAL_SCORE_ANIMATION_TIME_MS);
+    Tween finished[TWEEN_POOL_SIZE];
+    const uint32_t num_finished = tween_pool_update(game, state->frame_count, finished);
+
+    // Hexes to respawn, as stack index masks
+    uint32_t dead_petals[HEX_NUM_COLUMNS] = {0};
+    uint32_t dead_clusters[HEX_NUM_COLUMNS] = {0};
+    for (uint32_t i = 0; i < num_finished; i++) {
+        const Tween* tween = &finished[i];
+        switch (tween->done) {
+        case TWEEN_DONE_CLUSTER_MATCH:
+            dead_clusters[tween->q] |= 1u << tween->index;
+            break;
+        case TWEEN_DONE_FLOWER_PETAL:
+            dead_petals[tween->q] |= 1u << tween->index;
+            break;
+        case TWEEN_DONE_FLOWER_CENTER: {
+            // The new center hex can now be matched
+            Hex* hex = &hex_column(game, tween->q)[tween->index];
+            hex->is_matched = false;
+            hex->is_flower_matched = false;
+            set_match_animation(game, &hex_animation_column(game, tween->q)[tween->index], HEX_MATCH_ANIMATION_NONE);
+            mark_dirty(game, tween->q, hex_stack_index_to_row(tween->index));
+            break;
+        }
+        case TWEEN_DONE_LOCAL_SCORE:
+            game->local_score_animations[tween->index].in_progress = false;
+            break;
+        }
+    }
 
-        if (animation_progress > 1.0f) {
-            lsa->in_progress = false;
-        } else {
-            double alpha = 0.0f;
-            double height_delta = 0.0f;
-
-            { // alpha
-                double s0 = 1.0f;
-                double s1 = 0.1f;
-                double t = animation_progress;
-                t = t * t; // ease in, smash out
-                alpha = (1.0f - t) * s0 + t * s1;
-            }
+    // Flower perimeters are respawned before clusters, each column by column, which fixes
+    // the order random types are drawn in
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        if (dead_petals[q]) {
+            respawn_hexes(state, q, dead_petals[q]);
+        }
+    }
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        if (dead_clusters[q]) {
+            respawn_hexes(state, q, mask_after_erase(dead_clusters[q], dead_petals[q]));
+        }
+    }
+}
 
-            { // height_delta
-                double s0 = 0.0f;
-                double s1 = LOCAL_SCORE_ANIMATION_MAX_HEIGHT;
-                double t = animation_progress;
-                height_delta = (1.0f - t) * s0 + t * s1;
-            }
+static void start_hex_tween(Game* game, HexCoord coord, Tween tween) {
+    tween.q = coord.q;
+    tween.index = hex_row_to_stack_index(coord.r);
+    tween_pool_add(&game->tweens, &tween);
+}
 
-            lsa->alpha = alpha;
-            lsa->current_point.y = lsa->start_point.y - (int)height_delta;
+// Starts a local score animation rising from point, if there is a free slot
+static void start_local_score_animation(GameState* state, uint32_t score, Point point) {
+    Game* game = &state->game;
+    for (int i = 0; i < MAX_LOCAL_SCORE_ANIMATIONS; i++) {
+        LocalScoreAnimation* lsa = &game->local_score_animations[i];
+        if (lsa->in_progress) {
+            continue;
         }
+        *lsa = (LocalScoreAnimation){
+            .in_progress = true,
+            .score = score,
+            .alpha = 1.0f,
+            .start_point = point,
+            .current_point = point,
+        };
+        Tween tween = {
+            .start_time = state->frame_count,
+            .duration = ms_to_frames(LOCAL_SCORE_ANIMATION_TIME_MS),
+            .target = TWEEN_TARGET_LOCAL_SCORE_ALPHA,
+            .easing = TWEEN_EASING_QUADRATIC_IN, // ease in, smash out
+            .done = TWEEN_DONE_LOCAL_SCORE,
+            .index = i,
+            .from = 1.0f,
+            .to = 0.1f,
+        };
+        tween_pool_add(&game->tweens, &tween);
+        tween.target = TWEEN_TARGET_LOCAL_SCORE_Y;
+        tween.easing = TWEEN_EASING_LINEAR;
+        tween.done = TWEEN_DONE_NONE;
+        tween.from = point.y;
+        tween.to = point.y - LOCAL_SCORE_ANIMATION_MAX_HEIGHT;
+        tween_pool_add(&game->tweens, &tween);
+        return;
     }
-
-    // Erase completed animations
-    vector_erase_if(game->local_score_animations, local_score_animation_in_progress);
 }
 
-static void handle_input(void) {
+static void handle_input(GameState* state) {
+    Game* game = &state->game;
     bool go_up = false;
     bool go_down = false;
     bool go_left = false;
@@ -207,8 +251,9 @@ static void handle_input(void) {
     bool rotate_cw = false;
     bool rotate_ccw = false;
 
-    Input* input = &g_state.input;
-    Cursor* cursor = &g_state.cursor;
+    Input* input = &state->input;
+    Cursor* cursor = &state->cursor;
+    state->update_input = *input;
     if (input->up) {
         input->up = false;
         go_up = true;
@@ -227,7 +272,19 @@ static void handle_input(void) {
     }
     if (input->print_board) {
         input->print_board = false;
-        test_boards_print_current();
+        test_boards_print_current(game);
+    }
+    if (input->toggle_hint) {
+        input->toggle_hint = false;
+        state->show_hint = !state->show_hint;
+        LOG("Hint %s", state->show_hint ? "on" : "off");
+    }
+    if (input->run_benchmark) {
+        input->run_benchmark = false;
+        benchmark_match_kernels(game);
+        benchmark_moves(game);
+        benchmark_moves_index(game);
+        benchmark_ai(game);
     }
     if (input->rotate_cw) {
         input->rotate_cw = false;
@@ -239,33 +296,38 @@ static void handle_input(void) {
     }
 
     // Entire board needs to be stationary before we act on user input
-    if (!hex_all_stationary_no_animation()) {
+    if (!hex_all_stationary_no_animation(game)) {
         return;
     }
 
     bool cursor_moved = false;
     if (go_up) {
-        cursor_moved |= cursor_up(cursor);
+        cursor_moved |= cursor_up(game, cursor);
     }
     if (go_down) {
-        cursor_moved |= cursor_down(cursor);
+        cursor_moved |= cursor_down(game, cursor);
     }
     if (go_left) {
-        cursor_moved |= cursor_left(cursor);
+        cursor_moved |= cursor_left(game, cursor);
     }
     if (go_right) {
-        cursor_moved |= cursor_right(cursor);
+        cursor_moved |= cursor_right(game, cursor);
     }
 
     if (cursor_moved) {
-        audio_play_sound_effect(AUDIO_MOVE_CURSOR);
+        play_sound_effect(game, AUDIO_MOVE_CURSOR);
     }
 
 
-    bool start_rotation = rotate_cw || rotate_ccw;
+    // The hex under the cursor may have been matched and replaced since the cursor
+    // moved onto it, leaving nothing to rotate around
+    HexNeighbors cursor_hexes = {0};
+    cursor_neighbors(game, cursor, &cursor_hexes);
+
+    bool start_rotation = (rotate_cw || rotate_ccw) && (cursor_hexes.num_neighbors > 0);
     if (start_rotation && !game->rotation_animation.in_progress) {
         // Determine how many degrees to rotate based on hex type
-        HexType cursor_hex_type = hex_at(cursor->hex_anchor.q, cursor->hex_anchor.r)->type;
+        HexType cursor_hex_type = hex_at(game, cursor->hex_anchor.q, cursor->hex_anchor.r)->type;
         bool is_starflower_rotation =
             (cursor->position == CURSOR_POS_ON) && (cursor_hex_type == HEX_TYPE_STARFLOWER);
         bool is_blackflower_rotation =
@@ -278,9 +340,9 @@ static void handle_input(void) {
 
         game->rotation_animation = (RotationAnimation){
             .in_progress = true,
-            .start_time = g_state.frame_count,
+            .start_time = state->frame_count,
             .is_trio_rotation = is_trio_rotation,
-            .rotation_center = g_state.cursor.screen_point,
+            .rotation_center = state->cursor.screen_point,
             .degrees_to_rotate = degrees_to_rotate,
             .rotation_count = 0,
         };
@@ -288,42 +350,48 @@ static void handle_input(void) {
 }
 
 // Only modifies the hex type during rotation
-static void rotate_hexes(const HexCoord* coords, size_t num_coords, bool clockwise) {
+static void rotate_hexes(Game* game, const HexCoord* coords, size_t num_coords, bool clockwise) {
+    for (size_t i = 0; i < num_coords; i++) {
+        mark_dirty(game, coords[i].q, coords[i].r);
+    }
+
     if (clockwise) {
         // Take the one at the end and put it at the beginning
-        HexType end_hex_type = hex_at(coords[num_coords - 1].q, coords[num_coords - 1].r)->type;
+        HexType end_hex_type = hex_at(game, coords[num_coords - 1].q, coords[num_coords - 1].r)->type;
         for (int i = num_coords - 2; i >= 0; i--) {
-            const Hex* src = hex_at(coords[i].q, coords[i].r);
-            Hex* dest = hex_at(coords[i+1].q, coords[i+1].r);
+            const Hex* src = hex_at(game, coords[i].q, coords[i].r);
+            Hex* dest = hex_at(game, coords[i+1].q, coords[i+1].r);
             dest->type = src->type;
         }
-        hex_at(coords[0].q, coords[0].r)->type = end_hex_type;
+        hex_at(game, coords[0].q, coords[0].r)->type = end_hex_type;
     } else {
         // Take the one at the beginning and put it at the end
-        HexType beginning_hex_type = hex_at(coords[0].q, coords[0].r)->type;
+        HexType beginning_hex_type = hex_at(game, coords[0].q, coords[0].r)->type;
         for (int i = 0; i < num_coords - 1; i++) {
-            const Hex* src = hex_at(coords[i+1].q, coords[i+1].r);
-            Hex* dest = hex_at(coords[i].q, coords[i].r);
+            const Hex* src = hex_at(game, coords[i+1].q, coords[i+1].r);
+            Hex* dest = hex_at(game, coords[i].q, coords[i].r);
             dest->type = src->type;
         }
-        hex_at(coords[num_coords - 1].q, coords[num_coords - 1].r)->type = beginning_hex_type;
+        hex_at(game, coords[num_coords - 1].q, coords[num_coords - 1].r)->type = beginning_hex_type;
     }
 }
 
 // Returns true if rotation was completed.
-static void handle_rotation(void) {
+static void handle_rotation(GameState* state) {
+    Game* game = &state->game;
     if (!game->rotation_animation.in_progress) {
         return;
     }
 
-    Cursor* cursor = &g_state.cursor;
-    Hex* cursor_hex = hex_at(cursor->hex_anchor.q, cursor->hex_anchor.r);
+    Cursor* cursor = &state->cursor;
+    Hex* cursor_hex = hex_at(game, cursor->hex_anchor.q, cursor->hex_anchor.r);
+    HexAnimation* cursor_animation = hex_animation_at(game, cursor->hex_anchor.q, cursor->hex_anchor.r);
 
     HexNeighbors neighbors = {0};
-    cursor_neighbors(cursor, &neighbors);
+    cursor_neighbors(game, cursor, &neighbors);
 
     const double rotation_progress =
-        (double)((double)g_state.frame_count - (double)game->rotation_animation.start_time) /
+        (double)((double)state->frame_count - (double)game->rotation_animation.start_time) /
         (double)ms_to_frames(ROTATION_TIME_MS);
 
     // Rotation progress might be negative if we are stalling between automatic trio rotations.
@@ -332,406 +400,642 @@ static void handle_rotation(void) {
     }
 
     if (rotation_progress > 1.0f) {
-        cursor_hex->rotation_angle = 0.0f;
-        cursor_hex->scale = 1.0f;
+        cursor_animation->rotation_angle = 0.0f;
+        cursor_animation->scale = 1.0f;
 
         for (int i = 0; i < neighbors.num_neighbors; i++) {
-            Hex* hex = hex_at(neighbors.coords[i].q, neighbors.coords[i].r);
-            hex->rotation_angle = 0.0f;
-            hex->scale = 1.0f;
+            HexAnimation* animation = hex_animation_at(game, neighbors.coords[i].q, neighbors.coords[i].r);
+            animation->rotation_angle = 0.0f;
+            animation->scale = 1.0f;
         }
 
         bool is_rotate_clockwise = (game->rotation_animation.degrees_to_rotate > 0);
         if (cursor->position == CURSOR_POS_ON) {
             // starflower or black pearl rotation, rotate all neighbors
-            rotate_hexes(neighbors.coords, neighbors.num_neighbors, is_rotate_clockwise);
+            rotate_hexes(game, neighbors.coords, neighbors.num_neighbors, is_rotate_clockwise);
         } else {
             // normal trio rotation, rotate the cursor and two neighbors
             HexCoord hexes_to_rotate[3];
             hexes_to_rotate[0] = cursor->hex_anchor;
             hexes_to_rotate[1] = neighbors.coords[0];
             hexes_to_rotate[2] = neighbors.coords[1];
-            rotate_hexes(hexes_to_rotate, 3, is_rotate_clockwise);
+            rotate_hexes(game, hexes_to_rotate, 3, is_rotate_clockwise);
         }
 
         game->rotation_animation.rotation_count++;
         if (game->rotation_animation.is_trio_rotation &&
             (game->rotation_animation.rotation_count < 3) &&
-            !board_has_any_matches(true)) {
+            !board_has_any_matches(state, true)) {
             // Start another rotation in 100 ms
-            game->rotation_animation.start_time = g_state.frame_count + ms_to_frames(100);
+            game->rotation_animation.start_time = state->frame_count + ms_to_frames(100);
         } else {
             game->rotation_animation.in_progress = false;
             cursor_hex->is_rotating = false;
             for (int i = 0; i < neighbors.num_neighbors; i++) {
-                hex_at(neighbors.coords[i].q, neighbors.coords[i].r)->is_rotating = false;
+                hex_at(game, neighbors.coords[i].q, neighbors.coords[i].r)->is_rotating = false;
             }
         }
     } else {
         if (rotation_progress == 0.0f) {
             // TODO - play rotation sound effect
+            const Tween angle = {
+                .start_time = state->frame_count,
+                .duration = ms_to_frames(ROTATION_TIME_MS),
+                .target = TWEEN_TARGET_HEX_ROTATION_ANGLE,
+                .easing = TWEEN_EASING_LINEAR,
+                .from = 0.0f,
+                .to = game->rotation_animation.degrees_to_rotate,
+            };
+            const Tween scale = {
+                .start_time = state->frame_count,
+                .duration = ms_to_frames(ROTATION_TIME_MS),
+                .target = TWEEN_TARGET_HEX_SCALE,
+                .easing = TWEEN_EASING_PULSE,
+                .from = 1.0f,
+                .to = ROTATION_MAX_SCALE,
+            };
+            start_hex_tween(game, cursor->hex_anchor, angle);
+            start_hex_tween(game, cursor->hex_anchor, scale);
+            for (int i = 0; i < neighbors.num_neighbors; i++) {
+                start_hex_tween(game, neighbors.coords[i], angle);
+                start_hex_tween(game, neighbors.coords[i], scale);
+            }
         }
 
-        const double angle = rotation_progress * game->rotation_animation.degrees_to_rotate;
-        double scale = 1.0f;
-        if (rotation_progress < 0.5f) {
-            double s0 = 1.0f;
-            double s1 = ROTATION_MAX_SCALE;
-            double t = (rotation_progress / 0.5f);
-            scale = (1.0f - t) * s0 + t * s1;
-        } else {
-            double s0 = ROTATION_MAX_SCALE;
-            double s1 = 1.0f;
-            double t = ((rotation_progress - 0.5f) / 0.5f);
-            scale = (1.0f - t) * s0 + t * s1;
-        }
-
-        cursor_hex->rotation_angle = angle;
-        cursor_hex->scale = scale;
         cursor_hex->is_rotating = true;
-
         for (int i = 0; i < neighbors.num_neighbors; i++) {
-            Hex* hex = hex_at(neighbors.coords[i].q, neighbors.coords[i].r);
-            hex->is_rotating = true;
-            hex->rotation_angle = angle;
-            hex->scale = scale;
+            hex_at(game, neighbors.coords[i].q, neighbors.coords[i].r)->is_rotating = true;
         }
     }
 }
 
-static void handle_simple_cluster(const HexCoord* hex_coords, size_t num_coords) {
-    ASSERT(num_coords >= 3);
-
-    if (game->combos_remaining > 0) {
-        game->combos_remaining--;
-    }
-
-    for (size_t i = 0; i < num_coords; i++) {
-        HexCoord c = hex_coords[i];
-        Hex* hex = hex_at(c.q, c.r);
-        hex->is_matched = true;
-    }
-
-    // Compute score
-    //
+uint32_t game_simple_cluster_score(HexType type, size_t num_coords, uint32_t level) {
     // Basic:       (size - 2) * 5 * level
     // Multiplier:  (size - 2) * 100 * level
     // Starflower:  (size - 2) * 2500 * level
     // Black Pearl: (size - 2) * 25000 * level
     int score_multiplier = 0;
-    const Hex* hex = hex_at(hex_coords[0].q, hex_coords[0].r);
-    if (hex_is_basic(hex)) {
+    const Hex hex = { .type = type };
+    if (hex_is_basic(&hex)) {
         score_multiplier = 5;
-    } else if (hex_is_multiplier(hex)) {
+    } else if (hex_is_multiplier(&hex)) {
         score_multiplier = 100;
-    } else if (hex_is_starflower(hex)) {
+    } else if (hex_is_starflower(&hex)) {
         score_multiplier = 2500;
-    } else if (hex_is_black_pearl(hex)) {
-        // TODO - set flag to end game
+    } else if (hex_is_black_pearl(&hex)) {
         score_multiplier = 25000;
     } else {
         ASSERT(false && "Unknown hex type");
     }
-    int local_score = (num_coords - 2) * score_multiplier * game->level;
+    return (num_coords - 2) * score_multiplier * level;
+}
+
+uint32_t game_flower_score(HexType center_type, const HexType neighbor_types[6], uint32_t level) {
+    const Hex center_hex = { .type = center_type };
+    size_t num_neighbor_multipliers = 0;
+    bool all_neighbors_starflower = true;
+    bool all_neighbors_black_pearl = true;
+    for (size_t i = 0; i < 6; i++) {
+        const Hex n_hex = { .type = neighbor_types[i] };
+        num_neighbor_multipliers += (hex_is_multiplier(&n_hex) ? 1 : 0);
+        if (!hex_is_starflower(&n_hex)) {
+            all_neighbors_starflower = false;
+        }
+        if (!hex_is_black_pearl(&n_hex)) {
+            all_neighbors_black_pearl = false;
+        }
+    }
+
+    // Base score
+    double local_score = level * 1000.0f;
+
+    // Multiplier bonus for center hex
+    if (hex_is_starflower(&center_hex)) {
+        local_score *= 1.5f;
+    } else if (hex_is_black_pearl(&center_hex)) {
+        local_score *= 2.5f;
+    }
+
+    // Multiplier bonus for neighbor hexes
+    if (all_neighbors_starflower) {
+        local_score *= 10.0f;
+    } else if (all_neighbors_black_pearl) {
+        local_score *= 200.0f;
+    } else {
+        for (int i = 0; i < num_neighbor_multipliers; i++) {
+            local_score *= 2.0f;
+        }
+    }
+    return (uint32_t)local_score;
+}
+
+static void handle_simple_cluster(GameState* state, const HexCoord* hex_coords, size_t num_coords) {
+    Game* game = &state->game;
+    ASSERT(num_coords >= 3);
+
+    if (game->combos_remaining > 0) {
+        game->combos_remaining--;
+    }
+
+    for (size_t i = 0; i < num_coords; i++) {
+        HexCoord c = hex_coords[i];
+        Hex* hex = hex_at(game, c.q, c.r);
+        hex->is_matched = true;
+    }
+
+    // TODO - set flag to end game if black pearls were matched
+    const HexType type = hex_at(game, hex_coords[0].q, hex_coords[0].r)->type;
+    const uint32_t local_score = game_simple_cluster_score(type, num_coords, game->level);
     game->score += local_score;
 
     // Start cluster match animation for each hex in cluster
+    const Tween shrink = {
+        .start_time = state->frame_count,
+        .duration = ms_to_frames(CLUSTER_MATCH_ANIMATION_TIME_MS),
+        .target = TWEEN_TARGET_HEX_SCALE,
+        .easing = TWEEN_EASING_LINEAR,
+        .done = TWEEN_DONE_CLUSTER_MATCH,
+        .from = 1.0f,
+        .to = 0.0f,
+    };
     for (size_t i = 0; i < num_coords; i++) {
         HexCoord c = hex_coords[i];
-        ClusterMatchAnimation cma = {
-            .in_progress = true,
-            .start_time = g_state.frame_count,
-        };
-        hex_at(c.q, c.r)->cluster_match_animation = cma;
+        set_match_animation(game, hex_animation_at(game, c.q, c.r), HEX_MATCH_ANIMATION_CLUSTER);
+        start_hex_tween(game, c, shrink);
     }
 
     // Start local score animation
-    Rectangle r = hex_bounding_box_of_coords(hex_coords, num_coords);
+    Rectangle r = hex_bounding_box_of_coords(game, hex_coords, num_coords);
     Point cluster_center = {
         .x = r.top_left.x + r.width / 2,
         .y = r.top_left.y + r.height / 2,
     };
-    LocalScoreAnimation lsa = {
-        .in_progress = true,
-        .start_time = g_state.frame_count,
-        .score = (uint32_t)local_score,
-        .alpha = 1.0f,
-        .start_point = cluster_center,
-        .current_point = cluster_center,
-    };
-    text_init(&lsa.text);
-    vector_push_back(game->local_score_animations, &lsa);
+    start_local_score_animation(state, local_score, cluster_center);
 }
 
 // Computes score, updates combos remaining, marks hexes as matched,
 // and starts flower animation
-static void handle_flower(const HexCoord* hex_coords, size_t num_coords) {
+static void handle_flower(GameState* state, const HexCoord* hex_coords, size_t num_coords) {
+    Game* game = &state->game;
     ASSERT(num_coords == 7);
 
     if (game->combos_remaining > 0) {
         game->combos_remaining--;
     }
 
-    Hex* center_hex = hex_at(hex_coords[0].q, hex_coords[0].r);
-    bool starflower_center = hex_is_starflower(center_hex);
-    bool black_pearl_center = hex_is_black_pearl(center_hex);
+    Hex* center_hex = hex_at(game, hex_coords[0].q, hex_coords[0].r);
+    HexType neighbor_types[6];
+    for (size_t i = 0; i < 6; i++) {
+        neighbor_types[i] = hex_at(game, hex_coords[i+1].q, hex_coords[i+1].r)->type;
+    }
+    const uint32_t local_score = game_flower_score(center_hex->type, neighbor_types, game->level);
 
     center_hex->is_matched = true;
     center_hex->is_flower_matched = true;
-
-    size_t num_neighbor_multipliers = 0;
-    bool all_neighbors_starflower = true;
-    bool all_neighbors_black_pearl = true;
     for (size_t i = 0; i < 6; i++) {
-        Hex* n_hex = hex_at(hex_coords[i+1].q, hex_coords[i+1].r);
-        num_neighbor_multipliers += (hex_is_multiplier(n_hex) ? 1 : 0);
-        if (!hex_is_starflower(n_hex)) {
-            all_neighbors_starflower = false;
-        }
-        if (!hex_is_black_pearl(n_hex)) {
-            all_neighbors_black_pearl = false;
-        }
+        Hex* n_hex = hex_at(game, hex_coords[i+1].q, hex_coords[i+1].r);
         n_hex->is_matched = true;
         n_hex->is_flower_matched = true;
     }
 
-    if (all_neighbors_starflower) {
+    // All petals of a flower have the same type
+    const Hex petal = { .type = neighbor_types[0] };
+    if (hex_is_starflower(&petal)) {
         uint32_t mask = (1 << HEX_TYPE_BLACK_PEARL_UP) | (1 << HEX_TYPE_BLACK_PEARL_DOWN);
-        center_hex->type = hex_random_type_with_mask(mask);
-    } else if (all_neighbors_black_pearl) {
+        center_hex->type = hex_random_type_with_mask(&game->rng, mask);
+    } else if (hex_is_black_pearl(&petal)) {
         // TODO - set flag to end game
     } else {
-        audio_play_sound_effect(AUDIO_STARFLOWER);
+        play_sound_effect(game, AUDIO_STARFLOWER);
         center_hex->type = HEX_TYPE_STARFLOWER;
     }
 
-    // Base score
-    double local_score = game->level * 1000.0f;
-
-    // Multiplier bonus for center hex
-    if (starflower_center) {
-        local_score *= 1.5f;
-    } else if (black_pearl_center) {
-        local_score *= 2.5f;
-    }
-
-    // Multiplier bonus for neighbor hexes
-    if (all_neighbors_starflower) {
-        local_score *= 10.0f;
-    } else if (all_neighbors_black_pearl) {
-        local_score *= 200.0f;
-    } else {
-        for (int i = 0; i < num_neighbor_multipliers; i++) {
-            local_score *= 2.0f;
-        }
-    }
-
-    game->score += (uint32_t)local_score;
+    game->score += local_score;
 
     // Start flower match animation for each neighbor
+    const Point center_point = transform_hex_to_screen(hex_coords[0].q, hex_coords[0].r);
     Point flower_center = (Point){
-        .x = center_hex->hex_point.x + HEX_WIDTH / 2,
-        .y = center_hex->hex_point.y + HEX_HEIGHT / 2,
+        .x = center_point.x + HEX_WIDTH / 2,
+        .y = center_point.y + HEX_HEIGHT / 2,
     };
-    FlowerMatchAnimation fma = {
-        .in_progress = true,
-        .start_time = g_state.frame_count,
-        .flower_center = flower_center,
-        .is_center = false,
+    for (size_t i = 0; i < 7; i++) {
+        HexAnimation* animation = hex_animation_at(game, hex_coords[i].q, hex_coords[i].r);
+        set_match_animation(game, animation, HEX_MATCH_ANIMATION_FLOWER);
+        animation->flower_center = flower_center;
+    }
+    const Tween fade = {
+        .start_time = state->frame_count,
+        .duration = ms_to_frames(FLOWER_MATCH_ANIMATION_TIME_MS),
+        .target = TWEEN_TARGET_HEX_ALPHA,
+        .easing = TWEEN_EASING_QUADRATIC_IN, // ease in, smash out
+        .done = TWEEN_DONE_FLOWER_PETAL,
+        .from = 1.0f,
+        .to = 0.0f,
+    };
+    const Tween grow = {
+        .start_time = state->frame_count,
+        .duration = ms_to_frames(FLOWER_MATCH_ANIMATION_TIME_MS),
+        .target = TWEEN_TARGET_HEX_SCALE,
+        .easing = TWEEN_EASING_LINEAR,
+        .from = 1.0f,
+        .to = FLOWER_MATCH_MAX_SCALE,
     };
     for (size_t i = 0; i < 6; i++) {
-        Hex* n_hex = hex_at(hex_coords[i+1].q, hex_coords[i+1].r);
-        n_hex->flower_match_animation = fma;
+        start_hex_tween(game, hex_coords[i+1], fade);
+        start_hex_tween(game, hex_coords[i+1], grow);
     }
 
-    // Start flower match animation for center
-    fma.is_center = true;
-    center_hex->flower_match_animation = fma;
+    // The center stays, and is released once the petals are gone
+    const Tween center = {
+        .start_time = state->frame_count,
+        .duration = ms_to_frames(FLOWER_MATCH_ANIMATION_TIME_MS),
+        .target = TWEEN_TARGET_HEX_TIMER,
+        .done = TWEEN_DONE_FLOWER_CENTER,
+    };
+    start_hex_tween(game, hex_coords[0], center);
 
     // Start local score animation
-    LocalScoreAnimation lsa = {
-        .in_progress = true,
-        .start_time = g_state.frame_count,
-        .score = (uint32_t)local_score,
-        .alpha = 1.0f,
-        .start_point = flower_center,
-        .current_point = flower_center,
-    };
-    text_init(&lsa.text);
-    vector_push_back(game->local_score_animations, &lsa);
+    start_local_score_animation(state, local_score, flower_center);
 }
 
-static void handle_gravity(void) {
-    uint32_t now = g_state.frame_count;
+// Lands the hexes whose fall ends this frame. Nothing is done on other frames.
+static void handle_gravity(GameState* state) {
+    Game* game = &state->game;
+    uint32_t now = state->frame_count;
+    if (now < game->next_landing_time) {
+        return;
+    }
+
+    uint32_t next_landing_time = UINT32_MAX;
     for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = HEX_NUM_ROWS - 1; r >= 0; r--) {
-            Hex* hex = hex_at(q, r);
-            if (now < hex->gravity_start_time) {
+        if (!(game->falling_columns & (1u << q))) {
+            continue;
+        }
+        Hex* hexes = hex_column(game, q);
+        const HexMotion* motions = hex_motion_column(game, q);
+        bool is_falling = false;
+        for (int i = 0; i < (int)game->columns[q].size; i++) {
+            if (hexes[i].is_stationary) {
                 continue;
             }
-
-            hex->velocity = MIN(MAX_VELOCITY, hex->velocity + game->gravity);
-            hex->hex_point.y += hex->velocity;
-
-            const int final_y = transform_hex_to_screen(q, r).y;
-
-            if (hex->hex_point.y >= final_y) {
-                // We've reached the final position
-                hex->velocity = 0.0f;
-                hex->hex_point.y = final_y;
-                hex->is_stationary = true;
+            if (motions[i].landing_time <= now) {
+                // The landed cell may have formed a match
+                hexes[i].is_stationary = true;
+                game->num_falling_hexes--;
+                mark_dirty(game, q, hex_stack_index_to_row(i));
             } else {
-                hex->is_stationary = false;
-
-                // Still falling - check for collisions with the hex (or floor) below.
-                int y_below = (r == HEX_NUM_ROWS - 1) ?
-                    final_y + HEX_HEIGHT : // floor
-                    hex_at(q, r+1)->hex_point.y;
-
-                // Check if bottom of this hex is >= the y coord of the hex (or floor) below
-                bool collided = ((hex->hex_point.y + HEX_HEIGHT) >= y_below);
-                if (collided) {
-                    hex->velocity = 0.0f;
-                    hex->hex_point.y = y_below - HEX_HEIGHT;
-                }
+                is_falling = true;
+                next_landing_time = MIN(next_landing_time, motions[i].landing_time);
             }
         }
+        if (!is_falling) {
+            game->falling_columns &= ~(1u << q);
+        }
     }
+    game->next_landing_time = next_landing_time;
 
-    if (hex_all_stationary_no_animation()) {
+    if (game->falling_columns == 0) {
         game->gravity = GRAVITY_NORMAL;
     }
 }
 
+// A new match must include a cell that changed since the last check, so only the
+// triangles and flowers around dirty cells are re-evaluated before searching for
+// the matches.
+static bool dirty_cells_have_matches(Game* game, uint32_t* cells_examined) {
+    // Trios containing a dirty cell
+    for (BitboardMask m = game->dirty_cells; m; m &= m - 1) {
+        const HexCoord c = hex_index_to_coord(bitboard_first(m));
+        (*cells_examined)++;
+        if (hex_has_cluster_match(game, c.q, c.r, NULL, NULL, true)) {
+            return true;
+        }
+    }
+
+    // Flowers with a dirty center or petal
+    for (BitboardMask m = bitboard_dilate(game->dirty_cells); m; m &= m - 1) {
+        const HexCoord c = hex_index_to_coord(bitboard_first(m));
+        (*cells_examined)++;
+        if (hex_has_flower_match(game, c.q, c.r, true)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Lists the cells in mask in index order. Returns the number of cells.
+static size_t mask_indices(BitboardMask mask, uint8_t* indices) {
+    size_t num_indices = 0;
+    for (; mask; mask &= mask - 1) {
+        indices[num_indices++] = bitboard_first(mask);
+    }
+    return num_indices;
+}
+
 // Checking for combos is done in this order:
 //  * Flowers
 //  * Simple clusters (3, 4, or 5 of the same hex type, or multipliers clusters of any color)
 //  * Bomb diffusals (if combined with a multiplier, this will eliminate all of that color)
 //  * MMC clusters (whatever clusters remain, containing a mix of basic colors and multiplers)
-static void check_for_matches(void) {
+//
+// Every cell of a new trio or flower is a dirty cell or one of its neighbors, so the
+// searches only look there. Matching a flower can't form another one: its center and
+// every cell around it become matched.
+static void check_for_matches(GameState* state) {
+    Game* game = &state->game;
+    uint32_t cells_examined = 0;
+    const bool found_match = dirty_cells_have_matches(game, &cells_examined);
+    const BitboardMask near_dirty = bitboard_dilate(game->dirty_cells);
+    state->moves_index_dirty_cells |= game->dirty_cells;
+    game->dirty_cells = 0;
+    if (!found_match) {
+        state->match_cells_examined = cells_examined;
+        return;
+    }
+
+    uint8_t indices[HEX_NUM_INDICES];
+    const size_t num_indices = mask_indices(near_dirty, indices);
+
+    const bool use_bitboard = (state->match_kernel == MATCH_KERNEL_BITBOARD);
+    Bitboard bitboard;
+    if (use_bitboard) {
+        bitboard_from_board(&bitboard, game);
+    }
+
     size_t iteration = 0;
     // Match flowers
-    Vector flower = vector_create_with_allocator(
-            sizeof(HexCoord), bump_allocator_alloc, bump_allocator_free);
+    Vector flower = vector_create_with_allocator(sizeof(HexCoord),
+            bump_allocator_vector_alloc, bump_allocator_vector_free, &state->temporary_allocator);
     vector_reserve(flower, 7);
     while (1) {
         vector_clear(flower);
-        size_t flower_size = hex_find_one_flower(flower);
+        size_t flower_size = 0;
+        cells_examined += num_indices;
+        if (use_bitboard) {
+            flower_size = bitboard_find_one_flower(&bitboard, near_dirty, flower);
+        } else {
+            flower_size = hex_find_one_flower_at(game, indices, num_indices, flower);
+        }
         if (flower_size == 0) {
             break;
         }
-        handle_flower(vector_data_at(flower, 0), vector_size(flower));
+        handle_flower(state, vector_data_at(flower, 0), vector_size(flower));
+        if (use_bitboard) {
+            for (size_t i = 0; i < flower_size; i++) {
+                const HexCoord* c = vector_data_at(flower, i);
+                bitboard_update_cell(&bitboard, game, c->q, c->r);
+            }
+        }
         ASSERT(iteration++ < 100);
     }
 
-    // Match simple clusters
-    Vector simple_cluster = vector_create_with_allocator(
-            sizeof(HexCoord), bump_allocator_alloc, bump_allocator_free);
-    vector_reserve(simple_cluster, 5);
-    iteration = 0;
-    while (1) {
-        vector_clear(simple_cluster);
-        size_t simple_cluster_size = hex_find_one_simple_cluster(simple_cluster);
-        if (simple_cluster_size == 0) {
-            break;
-        }
-        // vector_print(simple_cluster, hex_coord_print);
-        handle_simple_cluster(vector_data_at(simple_cluster, 0), vector_size(simple_cluster));
-        ASSERT(iteration++ < 100);
+    // Match simple clusters. A hex can only be in one cluster.
+    const size_t max_coords = HEX_NUM_COLUMNS * HEX_NUM_ROWS;
+    const size_t max_clusters = max_coords / 3;
+    HexCluster* clusters = bump_allocator_alloc(&state->temporary_allocator, max_clusters * sizeof(HexCluster));
+    HexCoord* cluster_coords = bump_allocator_alloc(&state->temporary_allocator, max_coords * sizeof(HexCoord));
+    cells_examined += num_indices;
+    const size_t num_clusters = hex_find_simple_clusters_at(game, indices, num_indices,
+            clusters, max_clusters, cluster_coords, max_coords);
+    for (size_t i = 0; i < num_clusters; i++) {
+        handle_simple_cluster(state, clusters[i].coords, clusters[i].num_coords);
     }
+    state->match_cells_examined = cells_examined;
 
     // TODO - Match bomb cluster
     // TODO - Match MMCs
 }
 
-bool game_update(void) {
-    if (g_state.suspend_game) {
+// Brings the moves index up to date with the board, which must be at rest. Returns true
+// if any move matches.
+static bool board_has_matching_move(GameState* state) {
+    HexBoard board;
+    hex_board_from_game(&board, &state->game);
+    moves_index_update(&state->moves_index, &board);
+    return moves_index_any(&state->moves_index);
+}
+
+// Shuffles the valid hexes until the board has no matches but a move that matches, or
+// deals new boards until one does if that takes too many attempts
+static void reshuffle(GameState* state) {
+    Game* game = &state->game;
+    LOG("No moves left, reshuffling");
+    state->num_reshuffles++;
+
+    Hex* hexes[HEX_NUM_COLUMNS * HEX_NUM_ROWS];
+    HexType types[HEX_NUM_COLUMNS * HEX_NUM_ROWS];
+    size_t num_hexes = 0;
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        Hex* column = hex_column(game, q);
+        for (int i = 0; i < HEX_NUM_ROWS; i++) {
+            if (column[i].is_valid) {
+                hexes[num_hexes] = &column[i];
+                types[num_hexes++] = column[i].type;
+            }
+        }
+    }
+
+    bool playable = false;
+    for (int attempt = 0; attempt < RESHUFFLE_MAX_ATTEMPTS && !playable; attempt++) {
+        for (size_t i = num_hexes - 1; i > 0; i--) {
+            const uint32_t j = rng_below(&game->rng, i + 1);
+            const HexType type = types[i];
+            types[i] = types[j];
+            types[j] = type;
+        }
+        for (size_t i = 0; i < num_hexes; i++) {
+            hexes[i]->type = types[i];
+        }
+        playable = !board_has_any_matches(state, false) && board_has_matching_move(state);
+    }
+
+    if (!playable) {
+        LOG("Reshuffle failed, dealing a new board");
+    }
+    while (!playable) {
+        HexType new_types[HEX_NUM_COLUMNS * HEX_NUM_ROWS];
+        hex_random_match_free_types(&game->rng, hex_level_type_mask(game->level), new_types);
+        for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+            for (int i = 0; i < HEX_NUM_ROWS; i++) {
+                hex_column(game, q)[i].type = new_types[q * HEX_NUM_ROWS + i];
+            }
+        }
+        playable = board_has_matching_move(state);
+    }
+    game->dirty_cells = bitboard_all_cells();
+}
+
+// Once the board is at rest, brings the moves index up to date, and reshuffles a board
+// with no matching moves. Every change of type marks the cell dirty, right away or when
+// the hex lands, so there's nothing to do until then.
+static void handle_moves_index(GameState* state) {
+    Game* game = &state->game;
+    if ((state->moves_index.is_built && state->moves_index_dirty_cells == 0) ||
+        game->rotation_animation.in_progress ||
+        !hex_all_stationary_no_animation(game)) {
+        return;
+    }
+    HexBoard board;
+    hex_board_from_game(&board, game);
+    moves_index_update(&state->moves_index, &board);
+    state->moves_index_dirty_cells = 0;
+    if (!moves_index_any(&state->moves_index)) {
+        reshuffle(state);
+    }
+}
+
+bool game_has_any_matches(Game* game, MatchKernel kernel, bool require_stationary) {
+    if (kernel == MATCH_KERNEL_BITBOARD) {
+        Bitboard bitboard;
+        bitboard_from_board(&bitboard, game);
+        return bitboard_has_any_matches(&bitboard, require_stationary);
+    }
+
+    return hex_has_any_matches(game, require_stationary);
+}
+
+const char* game_match_kernel_name(MatchKernel kernel) {
+    if (kernel == MATCH_KERNEL_BITBOARD) {
+        return "bitboard";
+    } else if (kernel == MATCH_KERNEL_REFERENCE) {
+        return "reference";
+    } else {
+        return "unknown";
+    }
+}
+
+bool game_update(GameState* state) {
+    _current_state = state;
+    if (state->suspend_game) {
         return false;
     }
 
     // throttle to 1/12 of 60 Hz == 5 Hz
-    if (g_state.slow_mode) {
-        g_state.slow_mode_throttle++;
-        if (g_state.slow_mode_throttle < 12) {
+    if (state->slow_mode) {
+        state->slow_mode_throttle++;
+        if (state->slow_mode_throttle < 12) {
             return false;
         } else {
-            g_state.slow_mode_throttle = 0;
+            state->slow_mode_throttle = 0;
         }
     }
 
-    handle_input();
-    handle_rotation();
-    handle_local_score_animations();
-    handle_flower_match_animations();
-    handle_cluster_match_animations();
-    handle_gravity();
-    check_for_matches();
+    handle_input(state);
+    handle_rotation(state);
+    handle_animations(state);
+    handle_gravity(state);
+    check_for_matches(state);
+    handle_moves_index(state);
 
     return true;
 }
 
-bool game_init(void) {
-    game->seed = now_ms();
-    srand(game->seed);
+bool game_is_idle(GameState* state) {
+    if (state->suspend_game) {
+        return true;
+    }
+    const Input no_input = {0};
+    const Game* game = &state->game;
+    return
+        memcmp(&state->input, &no_input, sizeof(no_input)) == 0 &&
+        hex_all_stationary_no_animation(&state->game) &&
+        game->tweens.size == 0 &&
+        game->dirty_cells == 0 &&
+        state->moves_index.is_built &&
+        state->moves_index_dirty_cells == 0;
+}
+
+bool game_init(GameState* state) {
+    return game_init_with_seed(state, now_ms());
+}
+
+bool game_init_with_seed(GameState* state, uint32_t seed) {
+    Game* game = &state->game;
+    _current_state = state;
+    bump_allocator_init(&state->temporary_allocator,
+            state->temporary_allocations, sizeof(state->temporary_allocations));
+
+    LOG("Game seed: %u", seed);
+    game->seed = seed;
+    rng_seed(&game->rng, seed);
 
     game->level = 1;
     game->score = 0;
     game->combos_remaining = 50;
     game->gravity = GRAVITY_INITIAL;
+    game->falling_columns = 0;
+    game->num_falling_hexes = 0;
+    game->num_animating_hexes = 0;
+    game->next_landing_time = UINT32_MAX;
+    game->rotation_animation = (RotationAnimation){0};
 
     for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        game->hexes[q] = vector_create(sizeof(Hex));
-        vector_reserve(game->hexes[q], HEX_NUM_ROWS);
+        game->columns[q].size = 0;
     }
 
+    HexType types[HEX_NUM_COLUMNS * HEX_NUM_ROWS];
+    const bool match_free = hex_random_match_free_types(&game->rng, hex_level_type_mask(game->level), types);
+    ASSERT(match_free);
     for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
         for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            hex_spawn(q);
-        }
-    }
-
-    int reroll_attempts = 0;
-    while (board_has_any_matches(false)) {
-        reroll_attempts++;
-        ASSERT(reroll_attempts < 100);
-
-        // Fix cluster matches by rerolling (q,r)
-        for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-            for (int r = 0; r < HEX_NUM_ROWS; r++) {
-                if (hex_has_cluster_match(q, r, NULL, NULL, false)) {
-                    hex_at(q,r)->type = hex_random_type();
-                }
-            }
-        }
-
-        // Fix starflower matches by rerolling top neighbor
-        for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-            for (int r = 0; r < HEX_NUM_ROWS; r++) {
-                if (hex_has_flower_match(q, r, false)) {
-                    hex_at(q, r-1)->type = hex_random_type();
-                }
-            }
+            hex_spawn(game, q, types[q * HEX_NUM_ROWS + r]);
         }
     }
 
     // Trigger hexes to fall from above board column by column, left-to-right.
-    uint32_t now = g_state.frame_count;
+    uint32_t now = state->frame_count;
     for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
         uint32_t column_start_time = now + ms_to_frames(500) + q * ms_to_frames(350);
         for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            Hex* hex = hex_at(q, r);
-            hex->gravity_start_time = column_start_time + (HEX_NUM_ROWS - r - 1) * ms_to_frames(100);
+            HexMotion* motion = hex_motion_at(game, q, r);
+            motion->gravity_start_time = column_start_time + (HEX_NUM_ROWS - r - 1) * ms_to_frames(100);
         }
     }
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        schedule_falls(game, q, 0);
+    }
 
-    // For testing - load a specific board
-    // test_boards_load(g_test_board_six_black_pearls);
-    test_boards_load(g_test_board_yellow_starflower);
+#ifdef LOAD_TEST_BOARD
+    // For testing - open on a specific board instead of the one dealt from the seed
+    // test_boards_load(game, g_test_board_six_black_pearls);
+    test_boards_load(game, g_test_board_yellow_starflower);
+#endif
+    game->dirty_cells = bitboard_all_cells();
+    moves_index_reset(&state->moves_index);
+    state->moves_index_dirty_cells = 0;
+    state->num_reshuffles = 0;
 
-    cursor_init(&g_state.cursor);
+    cursor_init(&state->cursor);
 
-    game->local_score_animations = vector_create(sizeof(LocalScoreAnimation));
-    vector_reserve(game->local_score_animations, 10);
+    for (int i = 0; i < MAX_LOCAL_SCORE_ANIMATIONS; i++) {
+        game->local_score_animations[i].in_progress = false;
+    }
+    tween_pool_clear(&game->tweens);
 
     return true;
 }
+
+void game_deinit(GameState* state) {
+    bump_allocator_deinit(&state->temporary_allocator);
+    if (_current_state == state) {
+        _current_state = NULL;
+    }
+}
+
+void game_assert_failed(const char* file, int line) {
+    LOG(
+        "\n\n----\n"
+        "Assertion failed\n  %s:%d\n"
+        "----", file, line);
+
+    // Printing the board asserts too if the board itself is broken
+    GameState* state = _current_state;
+    if (state == NULL || _in_assert) {
+        return;
+    }
+    _in_assert = true;
+    test_boards_print_current(&state->game);
+    cursor_print(&state->cursor);
+    state->suspend_game = true;
+    _in_assert = false;
+}
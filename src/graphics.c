@@ -4,6 +4,8 @@
 #include "constants.h"
 #include "macros.h"
 #include "statistics.h"
+#include "text.h"
+#include "sprite_batch.h"
 #include <SDL_image.h>
 
 #define HEX_RADIUS 30
@@ -11,6 +13,14 @@
 #define HEX_SOURCE_HEIGHT 52
 #define DISPLAY_HEX_COORDS
 
+// The white hex drawn behind each hex under the cursor
+#define HIGHLIGHT_RADIUS (HEX_RADIUS + 6)
+
+// Highlights drawn with one SDL_RenderGeometry() call. The cursor covers at most 7 hexes.
+#define MAX_HIGHLIGHTS 8
+#define HIGHLIGHT_NUM_VERTICES 7 // middle, then corners
+#define HIGHLIGHT_NUM_INDICES 18 // 6 triangles around the middle
+
 #if 0 // 1080p
 #define CURSOR_RADIUS 12
 #define FONT_SIZE 24
@@ -23,8 +33,33 @@
 #define HEX_COORD_FONT_SIZE 12
 #endif
 
+// Filled concentric circles, rasterized once into a texture
+typedef struct {
+    SDL_Texture* texture;
+    int radius; // of the outermost circle
+} CircleSprite;
+
 typedef struct {
     SDL_Texture* hex_basic_texture;
+    CircleSprite cursor_sprite;
+    CircleSprite hint_sprite;
+    SpriteBatch hex_batch;
+
+    // The background, board and static hexes not under the cursor, see
+    // update_static_layer(). NULL if the renderer can't render to textures.
+    SDL_Texture* static_layer;
+    bool static_layer_valid; // false: redraw all of it
+    bool static_layer_cells[HEX_NUM_COLUMNS][HEX_NUM_ROWS]; // cells with a hex drawn
+    HexType static_layer_types[HEX_NUM_COLUMNS][HEX_NUM_ROWS];
+#ifdef USE_RENDER_GEOMETRY
+    // Queued by draw_highlight()
+    SDL_Vertex highlight_vertices[MAX_HIGHLIGHTS * HIGHLIGHT_NUM_VERTICES];
+    int highlight_indices[MAX_HIGHLIGHTS * HIGHLIGHT_NUM_INDICES];
+    int num_highlights;
+#else
+    SDL_Texture* highlight_texture;
+    SDL_Rect highlight_rect; // relative to the middle of the hex
+#endif
     TTF_Font* font;
     TTF_Font* local_score_font;
     TTF_Font* hex_coord_font;
@@ -35,7 +70,13 @@ typedef struct {
     Text fps_text;
     Text update_text;
     Text render_text;
+    Text match_cells_text;
+    Text local_score_text; // shared by all local score animations
     Text hex_coord_text[HEX_NUM_COLUMNS][HEX_NUM_ROWS];
+
+    // Set by graphics_update()
+    double interpolation;
+    uint32_t frame_count;
 } Graphics;
 
 static Graphics _graphics;
@@ -43,6 +84,7 @@ static Graphics _graphics;
 static const SDL_Color white = { .r = 0xff, .g = 0xff, .b = 0xff, .a = 0xff };
 static const SDL_Color darkorchid = { .r = 0x99, .g = 0x32, .b = 0xcc, .a = 0xff };
 static const SDL_Color black = { .r = 0, .g = 0, .b = 0, .a = 0xff };
+static const SDL_Color gold = { .r = 0xff, .g = 0xd7, .b = 0x00, .a = 0xff };
 
 static SDL_Texture* load_texture(const char* path) {
     SDL_Surface* surface = IMG_Load(path);
@@ -80,118 +122,208 @@ static bool load_all_graphics(void) {
     return true;
 }
 
+// Each circle is drawn over the ones before it, so radii should decrease. Pixels outside
+// the first circle are transparent.
+static bool create_circle_sprite(CircleSprite* sprite, int num_circles, const int* radii, const SDL_Color* colors) {
+    const int radius = radii[0];
+    const int size = 2 * radius + 1;
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, size, size, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) {
+        SDL_Log("SDL_CreateRGBSurfaceWithFormat failed: %s", SDL_GetError());
+        return false;
+    }
 
-static void draw_circle(Point center, int radius, SDL_Color color) {
-    SDL_SetRenderDrawColor(window_renderer(), color.r, color.g, color.b, color.a);
+    SDL_LockSurface(surface);
     for (int y = -radius; y <= radius; y++) {
+        Uint32* row = (Uint32*)((Uint8*)surface->pixels + (y + radius) * surface->pitch);
         for (int x = -radius; x <= radius; x++) {
-            if (x * x + y * y <= radius * radius) {
-                SDL_RenderDrawPoint(window_renderer(), center.x + x, center.y + y);
+            SDL_Color color = { 0 };
+            for (int i = 0; i < num_circles; i++) {
+                if (x * x + y * y <= radii[i] * radii[i]) {
+                    color = colors[i];
+                }
             }
+            row[x + radius] = SDL_MapRGBA(surface->format, color.r, color.g, color.b, color.a);
         }
     }
+    SDL_UnlockSurface(surface);
+
+    sprite->texture = SDL_CreateTextureFromSurface(window_renderer(), surface);
+    SDL_FreeSurface(surface);
+    if (sprite->texture == NULL) {
+        SDL_Log("SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(sprite->texture, SDL_BLENDMODE_BLEND);
+    sprite->radius = radius;
+    return true;
+}
+
+static bool create_all_sprites(void) {
+    const int cursor_radii[] = { CURSOR_RADIUS + 3, CURSOR_RADIUS, CURSOR_RADIUS - 1 };
+    const SDL_Color cursor_colors[] = { white, black, darkorchid };
+    const int hint_radii[] = { CURSOR_RADIUS / 2 + 2, CURSOR_RADIUS / 2 };
+    const SDL_Color hint_colors[] = { white, gold };
+    return
+        create_circle_sprite(&_graphics.cursor_sprite, 3, cursor_radii, cursor_colors) &&
+        create_circle_sprite(&_graphics.hint_sprite, 2, hint_radii, hint_colors);
+}
+
+static void draw_circle_sprite(const CircleSprite* sprite, Point center) {
+    SDL_Rect dest = {
+        .x = center.x - sprite->radius,
+        .y = center.y - sprite->radius,
+        .w = 2 * sprite->radius + 1,
+        .h = 2 * sprite->radius + 1,
+    };
+    SDL_RenderCopy(window_renderer(), sprite->texture, NULL, &dest);
 }
 
-static int compare_point_y(const void* point1, const void* point2) {
-    Point p1 = *(Point*)point1;
-    Point p2 = *(Point*)point2;
-    return p1.y - p2.y;
+// Corners of a flat topped hex of the given radius, clockwise from the left one
+static void hex_corners(Point middle, int radius, SDL_FPoint corners[6]) {
+    const int h = (int)(sqrt(3.0f) * (float)radius);
+    const int w = 2 * radius;
+    const float left = middle.x - w / 2;
+    const float top = middle.y - h / 2;
+    corners[0] = (SDL_FPoint){ left, top + h / 2 };
+    corners[1] = (SDL_FPoint){ left + w / 4, top };
+    corners[2] = (SDL_FPoint){ left + 3 * w / 4, top };
+    corners[3] = (SDL_FPoint){ left + w, top + h / 2 };
+    corners[4] = (SDL_FPoint){ left + 3 * w / 4, top + h };
+    corners[5] = (SDL_FPoint){ left + w / 4, top + h };
 }
 
-static void draw_bottom_flat_triangle(Point p1, Point p2, Point p3) {
-    float invslope1 = (p2.x - p1.x) / (p2.y - p1.y);
-    float invslope2 = (p3.x - p1.x) / (p3.y - p1.y);
-    float curx1 = p1.x;
-    float curx2 = p1.x;
-    for (int scanline_y = p1.y; scanline_y <= p2.y; scanline_y++) {
-        SDL_RenderDrawLine(window_renderer(), curx1, scanline_y, curx2, scanline_y);
-        curx1 += invslope1;
-        curx2 += invslope2;
+#ifdef USE_RENDER_GEOMETRY
+static bool init_highlights(void) {
+    for (int i = 0; i < MAX_HIGHLIGHTS; i++) {
+        const int middle = i * HIGHLIGHT_NUM_VERTICES;
+        int* indices = &_graphics.highlight_indices[i * HIGHLIGHT_NUM_INDICES];
+        for (int corner = 0; corner < 6; corner++) {
+            indices[3 * corner] = middle;
+            indices[3 * corner + 1] = middle + 1 + corner;
+            indices[3 * corner + 2] = middle + 1 + (corner + 1) % 6;
+        }
     }
+    _graphics.num_highlights = 0;
+    return true;
 }
 
-static void draw_top_flat_triangle(Point p1, Point p2, Point p3) {
-    float invslope1 = (p3.x - p1.x) / (p3.y - p1.y);
-    float invslope2 = (p3.x - p2.x) / (p3.y - p2.y);
-    float curx1 = p3.x;
-    float curx2 = p3.x;
-    for (int scanline_y = p3.y; scanline_y >= p1.y; scanline_y--) {
-        SDL_RenderDrawLine(window_renderer(), curx1, scanline_y, curx2, scanline_y);
-        curx1 -= invslope1;
-        curx2 -= invslope2;
+static void flush_highlights(void) {
+    if (_graphics.num_highlights == 0) {
+        return;
     }
+    if (0 != SDL_RenderGeometry(
+                window_renderer(),
+                NULL,
+                _graphics.highlight_vertices,
+                _graphics.num_highlights * HIGHLIGHT_NUM_VERTICES,
+                _graphics.highlight_indices,
+                _graphics.num_highlights * HIGHLIGHT_NUM_INDICES)) {
+        SDL_Log("SDL_RenderGeometry error %s", SDL_GetError());
+    }
+    _graphics.num_highlights = 0;
 }
 
-// Ref: http://www.sunshine2k.de/coding/java/TriangleRasterization/TriangleRasterization.html
-static void draw_filled_triangle(Point p1, Point p2, Point p3, SDL_Color color) {
-    // Sort points by y value, lowest to highest
-    Point points[3] = {p1, p2, p3};
-    qsort(points, 3, sizeof(Point), compare_point_y);
-
-    SDL_SetRenderDrawColor(window_renderer(), color.r, color.g, color.b, color.a);
-    if (points[1].y == points[2].y) {
-        draw_bottom_flat_triangle(points[0], points[1], points[2]);
-    } else if (points[0].y == points[1].y) {
-        draw_top_flat_triangle(points[0], points[1], points[2]);
-    } else {
-        // General case: Split into bottom-flat and top-flat triangles
-        Point p4 = {
-            .x = (int)(
-                    points[0].x +
-                    ((float)(points[1].y - points[0].y) / (float)(points[2].y - points[0].y)) *
-                    (points[2].x - points[0].x)),
-            .y = points[1].y
-        };
-        draw_bottom_flat_triangle(points[0], points[1], p4);
-        draw_top_flat_triangle(points[1], p4, points[2]);
-    }
-
-    // SDL_RenderDrawLine(window_renderer(), p1.x, p1.y, p2.x, p2.y);
-    // SDL_RenderDrawLine(window_renderer(), p2.x, p2.y, p3.x, p3.y);
-    // SDL_RenderDrawLine(window_renderer(), p3.x, p3.y, p1.x, p1.y);
+// Queues a highlight to be drawn by flush_highlights()
+static void draw_highlight(Point middle) {
+    if (_graphics.num_highlights == MAX_HIGHLIGHTS) {
+        flush_highlights();
+    }
+    SDL_FPoint corners[6];
+    hex_corners(middle, HIGHLIGHT_RADIUS, corners);
+    SDL_Vertex* vertices = &_graphics.highlight_vertices[_graphics.num_highlights * HIGHLIGHT_NUM_VERTICES];
+    vertices[0] = (SDL_Vertex){ .position = { middle.x, middle.y }, .color = white };
+    for (int corner = 0; corner < 6; corner++) {
+        vertices[1 + corner] = (SDL_Vertex){ .position = corners[corner], .color = white };
+    }
+    _graphics.num_highlights++;
 }
+#else
+// Without SDL_RenderGeometry(), the highlight is rasterized once into a texture
+static bool init_highlights(void) {
+    SDL_FPoint corners[6];
+    hex_corners((Point){ 0, 0 }, HIGHLIGHT_RADIUS, corners);
+    SDL_Rect* rect = &_graphics.highlight_rect;
+    rect->x = (int)corners[0].x;
+    rect->y = (int)corners[1].y;
+    rect->w = (int)corners[3].x - rect->x + 1;
+    rect->h = (int)corners[4].y - rect->y + 1;
+    SDL_Surface* surface = SDL_CreateRGBSurfaceWithFormat(0, rect->w, rect->h, 32, SDL_PIXELFORMAT_RGBA32);
+    if (surface == NULL) {
+        SDL_Log("SDL_CreateRGBSurfaceWithFormat failed: %s", SDL_GetError());
+        return false;
+    }
 
-static void draw_hex(Point middle, int radius, SDL_Color color) {
-    int h = (int)(sqrt(3.0f) * (float)radius);
-    int w = 2 * radius;
-    Point top_left = {
-        .x = middle.x - w / 2,
-        .y = middle.y - h / 2,
-    };
-    draw_filled_triangle(
-            (Point){top_left.x + w / 2, top_left.y + h / 2},
-            (Point){top_left.x, top_left.y + h / 2},
-            (Point){top_left.x + w / 4, top_left.y},
-            color);
-    draw_filled_triangle(
-            (Point){top_left.x + w / 2, top_left.y + h / 2},
-            (Point){top_left.x + w / 4, top_left.y},
-            (Point){top_left.x + 3 * w / 4, top_left.y},
-            color);
-    draw_filled_triangle(
-            (Point){top_left.x + w / 2, top_left.y + h / 2},
-            (Point){top_left.x + 3 * w / 4, top_left.y},
-            (Point){top_left.x + w, top_left.y + h / 2},
-            color);
-    draw_filled_triangle(
-            (Point){top_left.x + w / 2, top_left.y + h / 2},
-            (Point){top_left.x, top_left.y + h / 2},
-            (Point){top_left.x + w / 4, top_left.y + h},
-            color);
-    draw_filled_triangle(
-            (Point){top_left.x + w / 2, top_left.y + h / 2},
-            (Point){top_left.x + w / 4, top_left.y + h},
-            (Point){top_left.x + 3 * w / 4, top_left.y + h},
-            color);
-    draw_filled_triangle(
-            (Point){top_left.x + w / 2, top_left.y + h / 2},
-            (Point){top_left.x + 3 * w / 4, top_left.y + h},
-            (Point){top_left.x + w, top_left.y + h / 2},
-            color);
+    // Inside the top and bottom edges, and the slanted edges through the side corners
+    const float slant = (corners[1].x - corners[0].x) / (corners[0].y - corners[1].y);
+    SDL_LockSurface(surface);
+    for (int y = 0; y < rect->h; y++) {
+        Uint32* row = (Uint32*)((Uint8*)surface->pixels + y * surface->pitch);
+        const float py = (float)(rect->y + y);
+        for (int x = 0; x < rect->w; x++) {
+            const float px = (float)(rect->x + x);
+            const bool inside =
+                py >= corners[1].y && py <= corners[4].y &&
+                fabsf(px) <= corners[3].x - fabsf(py) * slant;
+            const SDL_Color color = inside ? white : (SDL_Color){ 0 };
+            row[x] = SDL_MapRGBA(surface->format, color.r, color.g, color.b, color.a);
+        }
+    }
+    SDL_UnlockSurface(surface);
+
+    _graphics.highlight_texture = SDL_CreateTextureFromSurface(window_renderer(), surface);
+    SDL_FreeSurface(surface);
+    if (_graphics.highlight_texture == NULL) {
+        SDL_Log("SDL_CreateTextureFromSurface failed: %s", SDL_GetError());
+        return false;
+    }
+    SDL_SetTextureBlendMode(_graphics.highlight_texture, SDL_BLENDMODE_BLEND);
+    return true;
+}
+
+static void flush_highlights(void) {
+}
+
+static void draw_highlight(Point middle) {
+    SDL_Rect dest = _graphics.highlight_rect;
+    dest.x += middle.x;
+    dest.y += middle.y;
+    SDL_RenderCopy(window_renderer(), _graphics.highlight_texture, NULL, &dest);
 }
+#endif
+
+// Past this many changed cells, the static layer is redrawn in one go
+#define STATIC_LAYER_MAX_CHANGED_CELLS 8
 
-bool graphics_init(void) {
-    if (!load_all_graphics()) {
+static bool init_static_layer(void) {
+    _graphics.static_layer = NULL;
+    _graphics.static_layer_valid = false;
+    if (!SDL_RenderTargetSupported(window_renderer())) {
+        SDL_Log("Render targets not supported, drawing the whole board every frame");
+        return true;
+    }
+    _graphics.static_layer = SDL_CreateTexture(
+            window_renderer(),
+            SDL_PIXELFORMAT_RGBA8888,
+            SDL_TEXTUREACCESS_TARGET,
+            LOGICAL_WINDOW_WIDTH,
+            LOGICAL_WINDOW_HEIGHT);
+    if (_graphics.static_layer == NULL) {
+        SDL_Log("SDL_CreateTexture failed, drawing the whole board every frame: %s", SDL_GetError());
+        return true;
+    }
+    // Opaque everywhere, so it replaces what's under it
+    SDL_SetTextureBlendMode(_graphics.static_layer, SDL_BLENDMODE_NONE);
+    return true;
+}
+
+bool graphics_init(GameState* state) {
+    Game* game = &state->game;
+    if (!load_all_graphics() || !create_all_sprites() || !init_highlights()) {
+        return false;
+    }
+    sprite_batch_init(&_graphics.hex_batch);
+    if (!init_static_layer()) {
         return false;
     }
 
@@ -199,7 +331,7 @@ bool graphics_init(void) {
     Text* score_text = &_graphics.score_text;
     text_init(score_text);
     text_set_font(score_text, _graphics.font);
-    snprintf(text_buffer(score_text), TEXT_MAX_LEN, "Score: %d", g_state.game.score);
+    snprintf(text_buffer(score_text), TEXT_MAX_LEN, "Score: %d", game->score);
     text_set_point(score_text, 20, 20);
     text_set_color(score_text, 0xFF, 0xFF, 0xFF, 0xFF);
     text_draw(score_text);
@@ -207,7 +339,7 @@ bool graphics_init(void) {
     Text* level_text = &_graphics.level_text;
     text_init(level_text);
     text_set_font(level_text, _graphics.font);
-    snprintf(text_buffer(level_text), TEXT_MAX_LEN, "Level: %d", g_state.game.level);
+    snprintf(text_buffer(level_text), TEXT_MAX_LEN, "Level: %d", game->level);
     text_set_point(level_text, 20, score_text->point.y + score_text->height + 20);
     text_set_color(level_text, 0xFF, 0xFF, 0xFF, 0xFF);
     text_draw(level_text);
@@ -215,7 +347,7 @@ bool graphics_init(void) {
     Text* combos_text = &_graphics.combos_text;
     text_init(combos_text);
     text_set_font(combos_text, _graphics.font);
-    snprintf(text_buffer(combos_text), TEXT_MAX_LEN, "Combos remaining: %d", g_state.game.combos_remaining);
+    snprintf(text_buffer(combos_text), TEXT_MAX_LEN, "Combos remaining: %d", game->combos_remaining);
     text_set_point(combos_text, 20, level_text->point.y + level_text->height + 20);
     text_set_color(combos_text, 0xFF, 0xFF, 0xFF, 0xFF);
     text_draw(combos_text);
@@ -251,8 +383,21 @@ bool graphics_init(void) {
     text_draw(render_text);
     text_set_point(render_text, LOGICAL_WINDOW_WIDTH - render_text->width - 20, 60);
     text_draw(render_text);
+
+    Text* match_cells_text = &_graphics.match_cells_text;
+    text_init(match_cells_text);
+    text_set_font(match_cells_text, _graphics.font);
+    snprintf(text_buffer(match_cells_text), TEXT_MAX_LEN, "Chk: %3.1f", 100.0f);
+    text_set_point(match_cells_text, LOGICAL_WINDOW_WIDTH, 80);
+    text_set_color(match_cells_text, 0xFF, 0xFF, 0xFF, 0xFF);
+    text_draw(match_cells_text);
+    text_set_point(match_cells_text, LOGICAL_WINDOW_WIDTH - match_cells_text->width - 20, 80);
+    text_draw(match_cells_text);
 #endif
 
+    text_init(&_graphics.local_score_text);
+    text_set_font(&_graphics.local_score_text, _graphics.local_score_font);
+
 #ifdef DISPLAY_HEX_COORDS
     for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
         for (int r = 0; r < HEX_NUM_ROWS; r++) {
@@ -274,10 +419,30 @@ bool graphics_init(void) {
     return true;
 }
 
-void draw_animated_hex(const Hex* hex, Point animation_center, bool is_cursor_hex) {
+static double lerp(double from, double to, double t) {
+    return from + (to - from) * t;
+}
+
+// Where the hex is drawn, between its positions before and after the last update
+static Point hex_draw_point(Game* game, int q, int r) {
+    return hex_position(game, q, r, (double)_graphics.frame_count - 1.0 + _graphics.interpolation);
+}
+
+static void draw_animated_hex(Game* game, int q, int r, Point animation_center) {
+    const Hex* hex = hex_at(game, q, r);
     if (!hex->is_valid) {
         return;
     }
+    const Point hex_point = hex_draw_point(game, q, r);
+    const HexAnimation* animation = hex_animation_at(game, q, r);
+
+    // Tweens only save the transformations on frames they run
+    double scale = animation->scale;
+    double rotation_angle = animation->rotation_angle;
+    if (animation->tween_frame + 1 == _graphics.frame_count) {
+        scale = lerp(animation->prev_scale, scale, _graphics.interpolation);
+        rotation_angle = lerp(animation->prev_rotation_angle, rotation_angle, _graphics.interpolation);
+    }
 
     SDL_Rect src = {
         .x = hex->type * HEX_SOURCE_WIDTH,
@@ -288,9 +453,9 @@ void draw_animated_hex(const Hex* hex, Point animation_center, bool is_cursor_he
 
 
     // Center point must be relative to hex
-    SDL_Point center = {
-        .x = animation_center.x - hex->hex_point.x,
-        .y = animation_center.y - hex->hex_point.y,
+    SDL_FPoint center = {
+        .x = animation_center.x - hex_point.x,
+        .y = animation_center.y - hex_point.y,
     };
 
     // Translate center point to origin
@@ -300,37 +465,37 @@ void draw_animated_hex(const Hex* hex, Point animation_center, bool is_cursor_he
     double dest_y = 0.0f;
     dest_x -= (double)center.x;
     dest_y -= (double)center.y;
-    dest_x *= (double)hex->scale;
-    dest_y *= (double)hex->scale;
+    dest_x *= scale;
+    dest_y *= scale;
     dest_x += (double)center.x;
     dest_y += (double)center.y;
-    dest_x += (double)hex->hex_point.x;
-    dest_y += (double)hex->hex_point.y;
+    dest_x += (double)hex_point.x;
+    dest_y += (double)hex_point.y;
 
-    SDL_Rect dest = {
+    SDL_FRect dest = {
         .x = dest_x,
         .y = dest_y,
-        .w = HEX_WIDTH * hex->scale,
-        .h = HEX_HEIGHT * hex->scale,
+        .w = HEX_WIDTH * scale,
+        .h = HEX_HEIGHT * scale,
     };
 
     // Center point is relative to dest, so we have to account for scaling factor here too.
-    center.x *= hex->scale;
-    center.y *= hex->scale;
+    center.x *= scale;
+    center.y *= scale;
 
-    SDL_SetTextureAlphaMod(_graphics.hex_basic_texture, hex->alpha * 255.0f);
-    SDL_RenderCopyEx(
-        window_renderer(),
+    sprite_batch_add(
+        &_graphics.hex_batch,
         _graphics.hex_basic_texture,
         &src,
         &dest,
-        hex->rotation_angle,
-        &center,
-        SDL_FLIP_NONE);
-    SDL_SetTextureAlphaMod(_graphics.hex_basic_texture, 255);
+        rotation_angle,
+        center,
+        animation->alpha * 255.0f);
 }
 
-void draw_static_hex(const Hex* hex) {
+// Draws the hex at (q, r) untransformed, with its top left at hex_point
+static void draw_static_hex(Game* game, int q, int r, Point hex_point) {
+    const Hex* hex = hex_at(game, q, r);
     if (!hex->is_valid) {
         return;
     }
@@ -342,21 +507,147 @@ void draw_static_hex(const Hex* hex) {
         .h = HEX_SOURCE_HEIGHT,
     };
 
-    SDL_Rect dest = {
-        .x = hex->hex_point.x,
-        .y = hex->hex_point.y,
+    SDL_FRect dest = {
+        .x = hex_point.x,
+        .y = hex_point.y,
         .w = HEX_WIDTH,
         .h = HEX_HEIGHT,
     };
 
-    if (0 != SDL_RenderCopy(window_renderer(), _graphics.hex_basic_texture, &src, &dest)) {
-        SDL_Log("SDL_RenderCopy error %s", SDL_GetError());
+    sprite_batch_add(&_graphics.hex_batch, _graphics.hex_basic_texture, &src, &dest, 0.0, (SDL_FPoint){ 0 }, 0xFF);
+}
+
+// Hexes and their highlights are drawn in layers, bottom first
+typedef enum {
+    DRAW_LAYER_STATIC,
+    DRAW_LAYER_ROTATING,
+    DRAW_LAYER_HIGHLIGHT,
+    DRAW_LAYER_CURSOR_STATIC,
+    DRAW_LAYER_CURSOR_ROTATING,
+    DRAW_LAYER_CLUSTER_MATCH,
+    DRAW_LAYER_FLOWER_MATCH,
+    DRAW_LAYER_FALLING,
+    NUM_DRAW_LAYERS,
+} DrawLayer;
+
+typedef struct {
+    uint8_t layer; // DrawLayer
+    uint8_t q;
+    uint8_t r;
+} DrawItem;
+
+// Every hex, and a highlight for each one under the cursor
+#define MAX_DRAW_ITEMS (2 * HEX_NUM_COLUMNS * HEX_NUM_ROWS)
+
+// Sorted by layer. Within a layer, items are in board order.
+typedef struct {
+    uint32_t size;
+    DrawItem items[MAX_DRAW_ITEMS];
+} DrawList;
+
+static DrawLayer hex_draw_layer(Game* game, int q, int r, bool in_cursor) {
+    const Hex* hex = hex_at(game, q, r);
+    const bool is_rotating = hex->is_rotating && game->rotation_animation.in_progress;
+    if (hex->is_stationary && !hex_is_animating(game, q, r)) {
+        return in_cursor ? DRAW_LAYER_CURSOR_STATIC : DRAW_LAYER_STATIC;
+    }
+    if (is_rotating) {
+        return in_cursor ? DRAW_LAYER_CURSOR_ROTATING : DRAW_LAYER_ROTATING;
+    }
+    switch (hex_animation_at(game, q, r)->match_animation) {
+    case HEX_MATCH_ANIMATION_CLUSTER:
+        return DRAW_LAYER_CLUSTER_MATCH;
+    case HEX_MATCH_ANIMATION_FLOWER:
+        return DRAW_LAYER_FLOWER_MATCH;
+    default:
+        return DRAW_LAYER_FALLING;
     }
 }
 
-void graphics_update(void) {
+// Classifies each hex once, then counting sorts the items by layer
+static void build_draw_list(GameState* state, bool cursor_active, DrawList* list) {
+    Game* game = &state->game;
+    bool in_cursor[HEX_NUM_COLUMNS][HEX_NUM_ROWS] = {{0}};
+    if (cursor_active) {
+        HexNeighbors cursor_hexes = {0};
+        cursor_neighbors(game, &state->cursor, &cursor_hexes);
+        in_cursor[state->cursor.hex_anchor.q][state->cursor.hex_anchor.r] = true;
+        for (int i = 0; i < cursor_hexes.num_neighbors; i++) {
+            in_cursor[cursor_hexes.coords[i].q][cursor_hexes.coords[i].r] = true;
+        }
+    }
+
+    DrawItem items[MAX_DRAW_ITEMS];
+    uint32_t num_items = 0;
+    uint32_t layer_starts[NUM_DRAW_LAYERS + 1] = {0};
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        for (int r = 0; r < HEX_NUM_ROWS; r++) {
+            const Hex* hex = hex_at(game, q, r);
+            if (in_cursor[q][r] && !hex->is_rotating) {
+                items[num_items++] = (DrawItem){ DRAW_LAYER_HIGHLIGHT, q, r };
+                layer_starts[DRAW_LAYER_HIGHLIGHT + 1]++;
+            }
+            if (hex->is_valid) {
+                const DrawLayer layer = hex_draw_layer(game, q, r, in_cursor[q][r]);
+                items[num_items++] = (DrawItem){ layer, q, r };
+                layer_starts[layer + 1]++;
+            }
+        }
+    }
+
+    for (int layer = 0; layer < NUM_DRAW_LAYERS; layer++) {
+        layer_starts[layer + 1] += layer_starts[layer];
+    }
+    for (uint32_t i = 0; i < num_items; i++) {
+        list->items[layer_starts[items[i].layer]++] = items[i];
+    }
+    list->size = num_items;
+}
+
+static void draw_item(Game* game, const DrawItem* item) {
+    const int q = item->q;
+    const int r = item->r;
+    const Point hex_point = hex_draw_point(game, q, r);
+    const Point middle = {
+        .x = hex_point.x + (HEX_WIDTH / 2),
+        .y = hex_point.y + (HEX_HEIGHT / 2),
+    };
+
+    // Highlights and hex sprites are batched separately, so switching between them flushes
+    if (item->layer == DRAW_LAYER_HIGHLIGHT) {
+        sprite_batch_flush(&_graphics.hex_batch);
+        draw_highlight(middle);
+        return;
+    }
+    flush_highlights();
+
+    switch (item->layer) {
+    case DRAW_LAYER_ROTATING:
+    case DRAW_LAYER_CURSOR_ROTATING:
+        draw_animated_hex(game, q, r, game->rotation_animation.rotation_center);
+        break;
+    case DRAW_LAYER_CLUSTER_MATCH:
+        draw_animated_hex(game, q, r, middle);
+        break;
+    case DRAW_LAYER_FLOWER_MATCH:
+        draw_animated_hex(game, q, r, hex_animation_at(game, q, r)->flower_center);
+        break;
+    default:
+        draw_static_hex(game, q, r, hex_point);
+        break;
+    }
+}
+
+// Unlike SDL_RenderClear(), keeps to the clip rect
+static void draw_background(void) {
     SDL_SetRenderDrawColor(window_renderer(), 0x44, 0x44, 0x44, 0xFF);
-    SDL_RenderClear(window_renderer());
+    SDL_Rect screen_rect = {
+        .x = 0,
+        .y = 0,
+        .w = LOGICAL_WINDOW_WIDTH,
+        .h = LOGICAL_WINDOW_HEIGHT,
+    };
+    SDL_RenderFillRect(window_renderer(), &screen_rect);
 
     SDL_SetRenderDrawColor(window_renderer(), 0x11, 0x11, 0x11, 0xFF);
     SDL_Rect board_rect = {
@@ -366,154 +657,149 @@ void graphics_update(void) {
         .h = g_constants.board_height
     };
     SDL_RenderFillRect(window_renderer(), &board_rect);
+}
 
-    const RotationAnimation* rotation_animation = &g_state.game.rotation_animation;
-    bool cursor_active =
-        hex_all_stationary_no_animation() || rotation_animation->in_progress;
-    bool drawn[HEX_NUM_COLUMNS][HEX_NUM_ROWS] = {{0}};
-    bool in_cursor[HEX_NUM_COLUMNS][HEX_NUM_ROWS] = {{0}};
+static SDL_Rect hex_cell_rect(int q, int r) {
+    const Point p = transform_hex_to_screen(q, r);
+    SDL_Rect rect = {
+        .x = p.x,
+        .y = p.y,
+        .w = HEX_WIDTH,
+        .h = HEX_HEIGHT,
+    };
+    return rect;
+}
 
-    // Mark hexes that are under the cursor
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            in_cursor[q][r] =
-                cursor_active &&
-                cursor_contains_hex(&g_state.cursor, (HexCoord){q,r});
-        }
+// Brings the static layer up to date with the first num_static items of the draw list,
+// which are the static layer's. Static hexes are drawn at their cells, where they come to
+// rest. Sprites overlap the rects of their neighbors, so a changed cell is cleared and
+// redrawn from every static hex over it, clipped to the cell.
+static void update_static_layer(Game* game, const DrawList* list, uint32_t num_static) {
+    bool has_hex[HEX_NUM_COLUMNS][HEX_NUM_ROWS] = {{0}};
+    for (uint32_t i = 0; i < num_static; i++) {
+        has_hex[list->items[i].q][list->items[i].r] = true;
     }
 
-    // Non-animated/static hexes, non-cursor
+    HexCoord changed[HEX_NUM_COLUMNS * HEX_NUM_ROWS];
+    int num_changed = 0;
     for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
         for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            const Hex* hex = hex_at(q,r);
-            if (hex->is_stationary && !hex_is_animating(hex) && !in_cursor[q][r]) {
-                draw_static_hex(hex);
-                drawn[q][r] = true;
+            const HexType type = hex_at(game, q, r)->type;
+            if (has_hex[q][r] != _graphics.static_layer_cells[q][r] ||
+                (has_hex[q][r] && type != _graphics.static_layer_types[q][r])) {
+                changed[num_changed++] = (HexCoord){ q, r };
             }
+            _graphics.static_layer_cells[q][r] = has_hex[q][r];
+            _graphics.static_layer_types[q][r] = type;
         }
     }
-
-    // Rotation animation, non-cursor
-    if (rotation_animation->in_progress) {
-        for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-            for (int r = 0; r < HEX_NUM_ROWS; r++) {
-                const Hex* hex = hex_at(q,r);
-                if (!drawn[q][r] && hex->is_rotating && !in_cursor[q][r]) {
-                    draw_animated_hex(hex, rotation_animation->rotation_center, false);
-                    drawn[q][r] = true;
-                }
-            }
-        }
+    if (_graphics.static_layer_valid && num_changed == 0) {
+        return;
     }
 
-    // Cursor highlights
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            if (in_cursor[q][r]) {
-                const Hex* hex = hex_at(q,r);
-                if (!hex->is_rotating) {
-                    Point middle = {
-                        hex->hex_point.x + HEX_WIDTH / 2,
-                        hex->hex_point.y + HEX_HEIGHT / 2,
-                    };
-                    draw_hex(middle, HEX_RADIUS + 6, white);
+    SDL_SetRenderTarget(window_renderer(), _graphics.static_layer);
+    if (!_graphics.static_layer_valid || num_changed > STATIC_LAYER_MAX_CHANGED_CELLS) {
+        draw_background();
+        for (uint32_t i = 0; i < num_static; i++) {
+            const DrawItem* item = &list->items[i];
+            draw_static_hex(game, item->q, item->r, transform_hex_to_screen(item->q, item->r));
+        }
+        sprite_batch_flush(&_graphics.hex_batch);
+    } else {
+        for (int i = 0; i < num_changed; i++) {
+            const SDL_Rect cell = hex_cell_rect(changed[i].q, changed[i].r);
+            SDL_RenderSetClipRect(window_renderer(), &cell);
+            draw_background();
+            for (uint32_t j = 0; j < num_static; j++) {
+                const DrawItem* item = &list->items[j];
+                const SDL_Rect rect = hex_cell_rect(item->q, item->r);
+                if (SDL_HasIntersection(&cell, &rect)) {
+                    draw_static_hex(game, item->q, item->r, transform_hex_to_screen(item->q, item->r));
                 }
             }
+            sprite_batch_flush(&_graphics.hex_batch);
         }
+        SDL_RenderSetClipRect(window_renderer(), NULL);
     }
+    SDL_SetRenderTarget(window_renderer(), NULL);
+    _graphics.static_layer_valid = true;
+}
 
-    // Non-animated/static hexes, cursor
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            const Hex* hex = hex_at(q,r);
-            if (hex->is_stationary && !hex_is_animating(hex) && in_cursor[q][r]) {
-                draw_static_hex(hex);
-                drawn[q][r] = true;
-            }
-        }
-    }
+void graphics_invalidate(void) {
+    _graphics.static_layer_valid = false;
+}
 
-    // Rotation animation, cursor
-    if (rotation_animation->in_progress) {
-        for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-            for (int r = 0; r < HEX_NUM_ROWS; r++) {
-                const Hex* hex = hex_at(q,r);
-                if (!drawn[q][r] && hex->is_rotating && in_cursor[q][r]) {
-                    draw_animated_hex(hex, rotation_animation->rotation_center, true);
-                    drawn[q][r] = true;
-                }
-            }
-        }
-    }
+void graphics_update(GameState* state, double interpolation) {
+    Game* game = &state->game;
+    _graphics.interpolation = interpolation;
+    _graphics.frame_count = state->frame_count;
 
-    // Hexes with cluster match animations
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            const Hex* hex = hex_at(q,r);
-            if (!drawn[q][r] && hex->cluster_match_animation.in_progress) {
-                Point center = {
-                    .x = hex->hex_point.x + (HEX_WIDTH / 2),
-                    .y = hex->hex_point.y + (HEX_HEIGHT / 2),
-                };
-                draw_animated_hex(hex, center, false);
-                drawn[q][r] = true;
-            }
-        }
-    }
+    const RotationAnimation* rotation_animation = &game->rotation_animation;
+    bool cursor_active =
+        hex_all_stationary_no_animation(game) || rotation_animation->in_progress;
 
-    // Hexes with flower match animations
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            const Hex* hex = hex_at(q,r);
-            if (!drawn[q][r] && hex->flower_match_animation.in_progress) {
-                draw_animated_hex(hex, hex->flower_match_animation.flower_center, false);
-                drawn[q][r] = true;
-            }
+    DrawList draw_list;
+    build_draw_list(state, cursor_active, &draw_list);
+
+    // The static layer is drawn first, so its items are at the start of the list
+    uint32_t first_item = 0;
+    if (_graphics.static_layer != NULL) {
+        while (first_item < draw_list.size && draw_list.items[first_item].layer == DRAW_LAYER_STATIC) {
+            first_item++;
         }
+        update_static_layer(game, &draw_list, first_item);
     }
 
-    // All remaining hexes (should just be the ones falling)
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            const Hex* hex = hex_at(q,r);
-            if (!drawn[q][r]) {
-                draw_static_hex(hex);
-                drawn[q][r] = true;
-            }
-        }
+    SDL_SetRenderDrawColor(window_renderer(), 0x44, 0x44, 0x44, 0xFF);
+    SDL_RenderClear(window_renderer());
+    if (_graphics.static_layer != NULL) {
+        SDL_RenderCopy(window_renderer(), _graphics.static_layer, NULL, NULL);
+    } else {
+        draw_background();
     }
 
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            ASSERT(drawn[q][r]);
-        }
+    for (uint32_t i = first_item; i < draw_list.size; i++) {
+        draw_item(game, &draw_list.items[i]);
     }
+    sprite_batch_flush(&_graphics.hex_batch);
+    flush_highlights();
 
     if (cursor_active) {
         // Draw cursor
-        draw_circle(g_state.cursor.screen_point, CURSOR_RADIUS+3, white);
-        draw_circle(g_state.cursor.screen_point, CURSOR_RADIUS, black);
-        draw_circle(g_state.cursor.screen_point, CURSOR_RADIUS-1, darkorchid);
+        draw_circle_sprite(&_graphics.cursor_sprite, state->cursor.screen_point);
+    }
+
+    // The moves index is only up to date while the board is at rest
+    Move hint;
+    if (state->show_hint &&
+        !rotation_animation->in_progress &&
+        cursor_active &&
+        moves_index_first(&state->moves_index, &hint)) {
+        Cursor hint_cursor;
+        cursor_set(&hint_cursor, hint.anchor, hint.position);
+        draw_circle_sprite(&_graphics.hint_sprite, hint_cursor.screen_point);
     }
 
     // Local score animations
-    LocalScoreAnimation* lsas = (LocalScoreAnimation*)vector_data_at(g_state.game.local_score_animations, 0);
-    for (size_t i = 0; i < vector_size(g_state.game.local_score_animations); i++) {
-        LocalScoreAnimation* lsa = &lsas[i];
-        text_set_font(&lsa->text, _graphics.local_score_font);
-        text_set_point(&lsa->text, lsa->current_point.x, lsa->current_point.y);
-        text_set_color(&lsa->text, 0xFF, 0xFF, 0xFF, (int)(255.0f * lsa->alpha));
-        snprintf(text_buffer(&lsa->text), TEXT_MAX_LEN, "%u", lsa->score);
-        text_draw(&lsa->text);
+    Text* local_score_text = &_graphics.local_score_text;
+    for (int i = 0; i < MAX_LOCAL_SCORE_ANIMATIONS; i++) {
+        const LocalScoreAnimation* lsa = &game->local_score_animations[i];
+        if (!lsa->in_progress) {
+            continue;
+        }
+        text_set_point(local_score_text, lsa->current_point.x, lsa->current_point.y);
+        text_set_color(local_score_text, 0xFF, 0xFF, 0xFF, (int)(255.0f * lsa->alpha));
+        snprintf(text_buffer(local_score_text), TEXT_MAX_LEN, "%u", lsa->score);
+        text_draw(local_score_text);
     }
 
-    snprintf(text_buffer(&_graphics.level_text), TEXT_MAX_LEN, "Level: %u", g_state.game.level);
+    snprintf(text_buffer(&_graphics.level_text), TEXT_MAX_LEN, "Level: %u", game->level);
     text_draw(&_graphics.level_text);
 
-    snprintf(text_buffer(&_graphics.combos_text), TEXT_MAX_LEN, "Combos remaining: %u", g_state.game.combos_remaining);
+    snprintf(text_buffer(&_graphics.combos_text), TEXT_MAX_LEN, "Combos remaining: %u", game->combos_remaining);
     text_draw(&_graphics.combos_text);
 
-    snprintf(text_buffer(&_graphics.score_text), TEXT_MAX_LEN, "Score: %u", g_state.game.score);
+    snprintf(text_buffer(&_graphics.score_text), TEXT_MAX_LEN, "Score: %u", game->score);
     text_draw(&_graphics.score_text);
 
 #ifdef DISPLAY_HEX_COORDS
@@ -530,16 +816,19 @@ void graphics_update(void) {
     Text* fps_text = &_graphics.fps_text;
     Text* update_text = &_graphics.update_text;
     Text* render_text = &_graphics.render_text;
+    Text* match_cells_text = &_graphics.match_cells_text;
 
-    uint32_t frames = g_state.frame_count;
+    uint32_t frames = state->frame_count;
     if (frames > 0 && frames % 60 == 0) {
         snprintf(text_buffer(fps_text), TEXT_MAX_LEN, "FPS: %3.1f", statistics_fps());
         snprintf(text_buffer(update_text), TEXT_MAX_LEN, "Upd: %3.1f", statistics_get()->update_ave_ns / 1000000.0f);
         snprintf(text_buffer(render_text), TEXT_MAX_LEN, "Rnd: %3.1f", statistics_get()->render_ave_ns / 1000000.0f);
+        snprintf(text_buffer(match_cells_text), TEXT_MAX_LEN, "Chk: %3.1f", statistics_get()->match_cells_ave);
     }
     text_draw(fps_text);
     text_draw(update_text);
     text_draw(render_text);
+    text_draw(match_cells_text);
 }
 
 void graphics_flip(void) {
@@ -1,9 +1,9 @@
 #include "hex.h"
-#include "game_state.h"
+#include "game.h"
 #include "constants.h"
-#include "bump_allocator.h"
 #include "macros.h"
-#include "window.h"
+#include "log.h"
+#include "topology.h"
 #include <macros.h>
 #include <math.h>
 
@@ -23,6 +23,12 @@ static const uint32_t LEVEL_HEX_TYPE_MASK[MAX_NUM_LEVELS + 1] = {
     [7] = 0x3F, // level 7, no change
 };
 
+// Returned by hex_at_index(TOPOLOGY_SENTINEL). Never valid, so it never matches.
+static const Hex _sentinel_hex = {
+    .is_valid = false,
+    .type = HEX_TYPE_INVALID,
+};
+
 bool hex_coord_is_valid(HexCoord coord) {
     if (coord.q < 0 || coord.r < 0) {
         return false;
@@ -36,6 +42,10 @@ bool hex_coord_is_valid(HexCoord coord) {
     return true;
 }
 
+HexCoord hex_index_to_coord(int index) {
+    return (HexCoord){ .q = index / HEX_INDEX_STRIDE, .r = index % HEX_INDEX_STRIDE };
+}
+
 HexCoord hex_neighbor_coord(int q, int r, HexNeighborID neighbor_id) {
     bool q_odd = (q & 1);
     HexCoord coord = {0};
@@ -66,7 +76,7 @@ HexCoord hex_neighbor_coord(int q, int r, HexNeighborID neighbor_id) {
             coord.r = (q_odd ? r - 1 : r);
             break;
         default:
-            SDL_Log("Invalid neighbor ID %d", neighbor_id);
+            LOG("Invalid neighbor ID %d", neighbor_id);
             ASSERT(false);
             break;
     }
@@ -89,151 +99,319 @@ int hex_stack_index_to_row(int stack_index) {
     return HEX_NUM_ROWS - stack_index - 1;
 }
 
-Hex* hex_spawn(int q) {
+int hex_spawn(Game* game, int q, HexType type) {
     ASSERT(q < HEX_NUM_COLUMNS);
-    Vector column = g_state.game.hexes[q];
-    int row = hex_stack_index_to_row(vector_size(column));
-    ASSERT(row < HEX_NUM_ROWS);
+    HexColumn* column = &game->columns[q];
+    ASSERT(column->size < HEX_NUM_ROWS);
+    int row = hex_stack_index_to_row(column->size);
 
     Hex new_hex = {
         .is_valid = true,
-        .type = hex_random_type(),
+        .type = type,
+    };
+    HexMotion new_motion = {
+        .fall_start_y = g_constants.hex_spawn_point[q].y,
+    };
+    HexAnimation new_animation = {
         .scale = 1.0f,
         .alpha = 1.0f,
-        .velocity = 0.0f,
-        .hex_point = g_constants.hex_spawn_point[q],
+        .prev_scale = 1.0f,
     };
 
     // For even columns, the last row of hexes are not valid
     bool q_even = ((q & 1) == 0);
     if (q_even && (row == HEX_NUM_ROWS - 1)) {
         new_hex.is_valid = false;
-        new_hex.hex_point = transform_hex_to_screen(q, row);
         new_hex.is_stationary = true;
+        new_motion.fall_start_y = transform_hex_to_screen(q, row).y;
     }
 
-    vector_push_back(column, &new_hex);
-    return vector_data_at(column, vector_size(column) - 1);
+    if (!new_hex.is_stationary) {
+        game->num_falling_hexes++;
+    }
+    column->hexes[column->size] = new_hex;
+    column->motion[column->size] = new_motion;
+    column->animations[column->size] = new_animation;
+    column->size++;
+    return row;
 }
 
-Hex* hex_at(int q, int r) {
+Hex* hex_at(Game* game, int q, int r) {
     ASSERT(q < HEX_NUM_COLUMNS && r < HEX_NUM_ROWS);
-    Vector column = g_state.game.hexes[q];
+    HexColumn* column = &game->columns[q];
 
     int stack_index = hex_row_to_stack_index(r);
-    ASSERT(stack_index < vector_size(column));
-    return vector_data_at(column, stack_index);
+    ASSERT(stack_index < column->size);
+    return &column->hexes[stack_index];
 }
 
-HexType hex_random_type(void) {
-    return hex_random_type_with_mask(LEVEL_HEX_TYPE_MASK[g_state.game.level]);
+HexMotion* hex_motion_at(Game* game, int q, int r) {
+    ASSERT(q < HEX_NUM_COLUMNS && r < HEX_NUM_ROWS);
+    HexColumn* column = &game->columns[q];
+
+    int stack_index = hex_row_to_stack_index(r);
+    ASSERT(stack_index < column->size);
+    return &column->motion[stack_index];
 }
 
-HexType hex_random_type_with_mask(uint32_t mask) {
-    // TODO - support for different odds of rolling multipliers and bombs
-    //
-    // For Hexic HD, people online report roughly 3% drop rate for multipliers.
-    // Not sure about bombs.
-    HexType allowed_types[NUM_HEX_TYPES] = {0};
-    size_t num_allowed_types = 0;
-    for (int bit = 0; bit < NUM_HEX_TYPES; bit++) {
-        if ((1 << bit) & mask) {
-            allowed_types[num_allowed_types++] = bit;
+HexAnimation* hex_animation_at(Game* game, int q, int r) {
+    ASSERT(q < HEX_NUM_COLUMNS && r < HEX_NUM_ROWS);
+    HexColumn* column = &game->columns[q];
+
+    int stack_index = hex_row_to_stack_index(r);
+    ASSERT(stack_index < column->size);
+    return &column->animations[stack_index];
+}
+
+Hex* hex_column(Game* game, int q) {
+    ASSERT(q < HEX_NUM_COLUMNS);
+    return game->columns[q].hexes;
+}
+
+HexMotion* hex_motion_column(Game* game, int q) {
+    ASSERT(q < HEX_NUM_COLUMNS);
+    return game->columns[q].motion;
+}
+
+HexAnimation* hex_animation_column(Game* game, int q) {
+    ASSERT(q < HEX_NUM_COLUMNS);
+    return game->columns[q].animations;
+}
+
+void hex_erase_dead(Game* game, int q) {
+    HexColumn* column = &game->columns[q];
+    size_t new_size = 0;
+    for (size_t i = 0; i < column->size; i++) {
+        if (column->hexes[i].is_dead) {
+            if (!column->hexes[i].is_stationary) {
+                game->num_falling_hexes--;
+            }
+            if (column->animations[i].match_animation != HEX_MATCH_ANIMATION_NONE) {
+                game->num_animating_hexes--;
+            }
+            continue;
+        }
+        if (new_size != i) {
+            column->hexes[new_size] = column->hexes[i];
+            column->motion[new_size] = column->motion[i];
+            column->animations[new_size] = column->animations[i];
         }
+        new_size++;
     }
-    int rand_allowed_type_index = rand() % num_allowed_types;
-    return allowed_types[rand_allowed_type_index];
+    column->size = new_size;
 }
 
-bool hex_has_cluster_match(int q, int r, HexCoord* n1, HexCoord* n2, bool require_stationary) {
-    if (!hex_coord_is_valid((HexCoord){q, r})) {
-        return false;
-    }
-    const Hex* query_hex = hex_at(q,r);
-    if (!query_hex->is_valid) {
-        return false;
+const Hex* hex_at_index(Game* game, int index) {
+    if (index == TOPOLOGY_SENTINEL) {
+        return &_sentinel_hex;
     }
+    const HexCoord c = g_topology.coords[index];
+    return hex_at(game, c.q, c.r);
+}
 
-    if (require_stationary && !query_hex->is_stationary) {
-        return false;
-    }
+uint32_t hex_level_type_mask(uint32_t level) {
+    ASSERT(level >= 1 && level <= MAX_NUM_LEVELS);
+    return LEVEL_HEX_TYPE_MASK[level];
+}
 
-    if (query_hex->is_matched) {
-        return false;
+// The n-th type set in mask
+static HexType nth_type_in_mask(uint32_t mask, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        mask &= mask - 1;
     }
+    return __builtin_ctz(mask);
+}
 
-    HexNeighbors neighbors = {0};
-    hex_neighbors(q, r, &neighbors, ALL_NEIGHBORS);
+HexType hex_random_type(Game* game) {
+    return hex_random_type_with_mask(&game->rng, hex_level_type_mask(game->level));
+}
 
-    for (int i = 0; i < neighbors.num_neighbors; i++) {
-        HexCoord c1 = neighbors.coords[i];
-        HexCoord c2 = neighbors.coords[(i + 1) % neighbors.num_neighbors];
-        if (!hex_coord_is_valid(c1) || !hex_coord_is_valid(c2)) {
-            continue;
+HexType hex_random_type_with_mask(Rng* rng, uint32_t mask) {
+    // TODO - support for different odds of rolling multipliers and bombs
+    //
+    // For Hexic HD, people online report roughly 3% drop rate for multipliers.
+    // Not sure about bombs.
+    ASSERT(mask != 0);
+    return nth_type_in_mask(mask, rng_below(rng, __builtin_popcount(mask)));
+}
+
+void hex_random_types(Rng* rng, uint32_t mask, HexType* types, size_t count) {
+    ASSERT(mask != 0);
+    const uint32_t num_types = __builtin_popcount(mask);
+    uint32_t values[HEX_NUM_COLUMNS * HEX_NUM_ROWS];
+    while (count > 0) {
+        const size_t n = MIN(count, ARRAY_SIZE(values));
+        rng_fill(rng, values, n);
+        for (size_t i = 0; i < n; i++) {
+            // Multiply-shift instead of rng_below(): the bias is under num_types / 2^32
+            types[i] = nth_type_in_mask(mask, ((uint64_t)values[i] * num_types) >> 32);
         }
+        types += n;
+        count -= n;
+    }
+}
 
-        const Hex* hex1 = hex_at(c1.q, c1.r);
-        if (require_stationary && !hex1->is_stationary) {
-            continue;
+// Types in cell_types that would complete a trio or flower at index. Cells not filled
+// yet, invalid cells and the sentinel are HEX_TYPE_INVALID.
+static uint32_t match_completing_types(const HexType* cell_types, int index) {
+    uint32_t types = 0;
+    const uint8_t* neighbors = g_topology.neighbors[index];
+    for (int i = 0; i < MAX_NUM_HEX_NEIGHBORS; i++) {
+        // Trio with two adjacent neighbors
+        const HexType type = cell_types[neighbors[i]];
+        if (type != HEX_TYPE_INVALID && type == cell_types[neighbors[(i + 1) % MAX_NUM_HEX_NEIGHBORS]]) {
+            types |= 1u << type;
         }
-        if (hex1->is_matched) {
+
+        // Last cell of the ring around a flower center. The center's own type doesn't matter.
+        const int center = neighbors[i];
+        if (center == TOPOLOGY_SENTINEL) {
             continue;
         }
-        const Hex* hex2 = hex_at(c2.q, c2.r);
-        if (require_stationary && !hex2->is_stationary) {
-            continue;
+        const uint8_t* ring = g_topology.neighbors[center];
+        HexType ring_type = HEX_TYPE_INVALID;
+        int num_filled = 0;
+        for (int j = 0; j < MAX_NUM_HEX_NEIGHBORS; j++) {
+            if (ring[j] == index) {
+                continue;
+            }
+            const HexType t = cell_types[ring[j]];
+            if (t == HEX_TYPE_INVALID || (ring_type != HEX_TYPE_INVALID && t != ring_type)) {
+                break;
+            }
+            ring_type = t;
+            num_filled++;
         }
-        if (hex2->is_matched) {
-            continue;
+        if (num_filled == MAX_NUM_HEX_NEIGHBORS - 1) {
+            types |= 1u << ring_type;
         }
+    }
+    return types;
+}
+
+bool hex_random_match_free_types(Rng* rng, uint32_t mask, HexType* types) {
+    ASSERT(mask != 0);
+    HexType cell_types[TOPOLOGY_NUM_CELLS];
+    for (int i = 0; i < TOPOLOGY_NUM_CELLS; i++) {
+        cell_types[i] = HEX_TYPE_INVALID;
+    }
 
-        if ((hex1->type == query_hex->type) && (hex2->type == query_hex->type)) {
-            if (n1) {
-                *n1 = c1;
+    // Filling column by column, bottom to top, a cell has at most 3 filled neighbors, in a
+    // row. Both trios they can make include the middle one, so they rule out at most one
+    // type. Only the flower centered on the lower left neighbor can be completed, which
+    // rules out one more.
+    bool match_free = true;
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        for (int i = 0; i < HEX_NUM_ROWS; i++) {
+            const int index = HEX_INDEX(q, hex_stack_index_to_row(i));
+            uint32_t allowed = mask;
+            if (g_topology.is_valid[index]) {
+                allowed &= ~match_completing_types(cell_types, index);
+                if (allowed == 0) {
+                    allowed = mask;
+                    match_free = false;
+                }
             }
-            if (n2) {
-                *n2 = c2;
+            const HexType type = nth_type_in_mask(allowed, rng_below(rng, __builtin_popcount(allowed)));
+            if (g_topology.is_valid[index]) {
+                cell_types[index] = type;
             }
-            return true;
+            types[q * HEX_NUM_ROWS + i] = type;
         }
     }
-    return false;
+    return match_free;
 }
 
+size_t hex_random_match_free_boards(Rng* rng, uint32_t mask, HexType* types, size_t num_boards) {
+    size_t num_match_free = 0;
+    for (size_t i = 0; i < num_boards; i++) {
+        num_match_free += hex_random_match_free_types(rng, mask, &types[i * HEX_NUM_COLUMNS * HEX_NUM_ROWS]) ? 1 : 0;
+    }
+    return num_match_free;
+}
 
-bool hex_has_flower_match(int q, int r, bool require_stationary) {
-    const Hex* query_hex = hex_at(q, r);
-    if (!query_hex->is_valid) {
+static bool hex_is_matchable(const Hex* hex, bool require_stationary) {
+    if (!hex->is_valid || hex->is_matched) {
         return false;
     }
+    return hex->is_stationary || !require_stationary;
+}
+
+// Hex at a cell index of board, or of the board of game if board is NULL
+static const Hex* cell_at(const HexBoard* board, Game* game, int index) {
+    return board ? &board->cells[index] : hex_at_index(game, index);
+}
 
-    if (require_stationary && !query_hex->is_stationary) {
+// Available to start or join a cluster: matchable, and not labeled by an earlier cluster.
+// labels may be NULL.
+static bool hex_is_unlabeled(const HexBoard* board, Game* game, int index, const uint8_t* labels, bool require_stationary) {
+    if (labels && labels[index] != 0) {
         return false;
     }
+    return hex_is_matchable(cell_at(board, game, index), require_stationary);
+}
 
-    if (query_hex->is_matched) {
+// Finds the first trio containing index, checking neighbor pairs in clockwise order.
+static bool find_trio(
+        const HexBoard* board, Game* game, int index, const uint8_t* labels, bool require_stationary, int* i1, int* i2) {
+    if (!hex_is_unlabeled(board, game, index, labels, require_stationary)) {
         return false;
     }
+    const HexType type = cell_at(board, game, index)->type;
+
+    // Invalid neighbors are the sentinel hex, which is never matchable
+    const uint8_t* neighbors = g_topology.neighbors[index];
+    for (int i = 0; i < MAX_NUM_HEX_NEIGHBORS; i++) {
+        const int n1 = neighbors[i];
+        const int n2 = neighbors[(i + 1) % MAX_NUM_HEX_NEIGHBORS];
+        if (cell_at(board, game, n1)->type != type || !hex_is_unlabeled(board, game, n1, labels, require_stationary)) {
+            continue;
+        }
+        if (cell_at(board, game, n2)->type != type || !hex_is_unlabeled(board, game, n2, labels, require_stationary)) {
+            continue;
+        }
+        *i1 = n1;
+        *i2 = n2;
+        return true;
+    }
+    return false;
+}
 
-    HexNeighbors neighbors = {0};
-    hex_neighbors(q, r, &neighbors, ALL_NEIGHBORS);
+bool hex_has_cluster_match(Game* game, int q, int r, HexCoord* n1, HexCoord* n2, bool require_stationary) {
+    if (!hex_coord_is_valid((HexCoord){q, r})) {
+        return false;
+    }
 
-    // Check that all neighbors are valid
-    for (int i = 0; i < neighbors.num_neighbors; i++) {
-        HexCoord c = neighbors.coords[i];
-        if (!hex_coord_is_valid(c)) {
-            return false;
-        }
+    int i1 = 0;
+    int i2 = 0;
+    if (!find_trio(NULL, game, HEX_INDEX(q, r), NULL, require_stationary, &i1, &i2)) {
+        return false;
     }
+    if (n1) {
+        *n1 = g_topology.coords[i1];
+    }
+    if (n2) {
+        *n2 = g_topology.coords[i2];
+    }
+    return true;
+}
 
-    // Check that all neighbors are matchable and have the same type.
+static bool flower_match(const HexBoard* board, Game* game, int index, bool require_stationary) {
+    if (!hex_is_matchable(cell_at(board, game, index), require_stationary)) {
+        return false;
+    }
+
+    // Check that all neighbors are valid, matchable and have the same type.
     // Note: we allow a neighbor hex to be already matched with another
     // flower.
-    HexType type = hex_at(neighbors.coords[0].q, neighbors.coords[0].r)->type;
-    for (int i = 1; i < neighbors.num_neighbors; i++) {
-        HexCoord coord = neighbors.coords[i];
+    const uint8_t* neighbors = g_topology.neighbors[index];
+    HexType type = cell_at(board, game, neighbors[0])->type;
+    for (int i = 0; i < MAX_NUM_HEX_NEIGHBORS; i++) {
+        const Hex* neighbor_hex = cell_at(board, game, neighbors[i]);
+        if (!neighbor_hex->is_valid) {
+            return false;
+        }
 
-        const Hex* neighbor_hex = hex_at(coord.q, coord.r);
         if (require_stationary && !neighbor_hex->is_stationary) {
             return false;
         }
@@ -249,132 +427,169 @@ bool hex_has_flower_match(int q, int r, bool require_stationary) {
     return true;
 }
 
-size_t hex_find_one_flower(Vector hex_coords) {
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            if (hex_has_flower_match(q, r, true)) {
-                HexNeighbors neighbors = {0};
-                hex_neighbors(q, r, &neighbors, ALL_NEIGHBORS);
-                ASSERT(neighbors.num_neighbors == 6);
-
-                HexCoord c = (HexCoord){ .q = q, .r = r };
-                vector_push_back(hex_coords, &c);
-                for (int i = 0; i < 6; i++) {
-                    vector_push_back(hex_coords, &neighbors.coords[i]);
-                }
-                return 7;
-            }
+bool hex_has_flower_match(Game* game, int q, int r, bool require_stationary) {
+    return flower_match(NULL, game, HEX_INDEX(q, r), require_stationary);
+}
+
+bool hex_has_any_matches(Game* game, bool require_stationary) {
+    // Each trio is checked exactly once
+    for (size_t t = 0; t < g_topology.num_triangles; t++) {
+        const TopologyTriangle* triangle = &g_topology.triangles[t];
+        const Hex* hex0 = hex_at_index(game, triangle->cells[0]);
+        const Hex* hex1 = hex_at_index(game, triangle->cells[1]);
+        const Hex* hex2 = hex_at_index(game, triangle->cells[2]);
+        if (hex0->type == hex1->type &&
+            hex0->type == hex2->type &&
+            hex_is_matchable(hex0, require_stationary) &&
+            hex_is_matchable(hex1, require_stationary) &&
+            hex_is_matchable(hex2, require_stationary)) {
+            return true;
         }
     }
-    return 0;
+
+    for (size_t i = 0; i < g_topology.num_flower_centers; i++) {
+        const HexCoord c = g_topology.coords[g_topology.flower_centers[i]];
+        if (hex_has_flower_match(game, c.q, c.r, require_stationary)) {
+            return true;
+        }
+    }
+    return false;
 }
 
-size_t hex_find_one_simple_cluster(Vector hex_coords) {
-    bool in_cluster[HEX_NUM_COLUMNS][HEX_NUM_ROWS] = {{0}};
-    Vector dfs_stack = vector_create_with_allocator(
-            sizeof(HexCoord),
-            bump_allocator_alloc,
-            bump_allocator_free);
-    vector_reserve(dfs_stack, 10);
+size_t hex_find_one_flower(Game* game, Vector hex_coords) {
+    // Only cells with six valid neighbors can be a flower center
+    return hex_find_one_flower_at(game, g_topology.flower_centers, g_topology.num_flower_centers, hex_coords);
+}
 
-    // Iterate over the entire board.
-    // Find the first trio cluster (all same type, none previously matched).
-    // DFS, starting with the trio, visit neighboring hexes that should be part of the cluster.
-    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            HexCoord n1, n2;
-            if (!hex_has_cluster_match(q, r, &n1, &n2, true)) {
-                continue;
+size_t hex_find_one_flower_at(Game* game, const uint8_t* centers, size_t num_centers, Vector hex_coords) {
+    for (size_t i = 0; i < num_centers; i++) {
+        const int index = centers[i];
+        const HexCoord c = g_topology.coords[index];
+        if (hex_has_flower_match(game, c.q, c.r, true)) {
+            vector_push_back(hex_coords, &c);
+            for (int id = 0; id < MAX_NUM_HEX_NEIGHBORS; id++) {
+                vector_push_back(hex_coords, &g_topology.coords[g_topology.neighbors[index][id]]);
             }
+            return 7;
+        }
+    }
+    return 0;
+}
 
-            vector_clear(dfs_stack);
-            vector_clear(hex_coords);
-
-            HexCoord start = {q,r};
-            in_cluster[q][r] = true;
-            vector_push_back(dfs_stack, &start);
-
-            in_cluster[n1.q][n1.r] = true;
-            vector_push_back(dfs_stack, &n1);
-
-            in_cluster[n2.q][n2.r] = true;
-            vector_push_back(dfs_stack, &n2);
-
-            HexType target_type = hex_at(q, r)->type;
-
-            while (vector_size(dfs_stack) > 0) {
-                HexCoord c = {0};
-                vector_pop_back(dfs_stack, &c);
-                // SDL_Log("Pop (%d,%d)", c.q, c.r);
-                vector_push_back(hex_coords, &c);
-
-                // Add neighbors to cluster if they meet all criteria:
-                //   1. Valid
-                //   2. Stationary
-                //   2. Not already matched
-                //   3. Not already in cluster
-                //   4. Type matches
-                //   5. Prior or next neighbor type matches and in cluster
-                HexNeighbors neighbors = {0};
-                hex_neighbors(c.q, c.r, &neighbors, ALL_NEIGHBORS);
-                for (int i = 0; i < neighbors.num_neighbors; i++) {
-                    HexCoord c1 = (i == 0 ?
-                            neighbors.coords[neighbors.num_neighbors - 1] :
-                            neighbors.coords[i - 1]);
-                    HexCoord c2 = neighbors.coords[i];
-                    HexCoord c3 = neighbors.coords[(i + 1) % neighbors.num_neighbors];
-
-                    // Check criteria of the middle neighbor
-                    if (!hex_coord_is_valid(c2)) {
-                        continue;
-                    }
-
-                    const Hex* hex2 = hex_at(c2.q, c2.r);
-                    if (!hex2->is_stationary) {
-                        continue;
-                    }
-                    if (hex2->is_matched) {
-                        continue;
-                    }
-                    if (in_cluster[c2.q][c2.r]) {
-                        continue;
-                    }
-                    if (hex2->type != target_type) {
-                        continue;
-                    }
-
-                    // Check prior neighbor
-                    if (hex_coord_is_valid(c1) && hex_at(c1.q, c1.r)->type == target_type && in_cluster[c1.q][c1.r]) {
-                        // SDL_Log("(%d,%d), Add (%d,%d)", c.q, c.r, c2.q, c2.r);
-                        vector_push_back(dfs_stack, &c2);
-                        in_cluster[c2.q][c2.r] = true;
-                        continue;
-                    }
-
-                    // Check next neighbor
-                    if (hex_coord_is_valid(c3) && hex_at(c3.q, c3.r)->type == target_type && in_cluster[c3.q][c3.r]) {
-                        // SDL_Log("(%d,%d), Add (%d,%d)", c.q, c.r, c2.q, c2.r);
-                        vector_push_back(dfs_stack, &c2);
-                        in_cluster[c2.q][c2.r] = true;
-                    }
+// Seeds clusters at the cells in seeds, or at every cell if seeds is NULL
+static size_t find_all_simple_clusters(const HexBoard* board, Game* game, const uint8_t* seeds, size_t num_seeds,
+        HexCluster* clusters, size_t max_clusters, HexCoord* coords, size_t max_coords) {
+    // 0 is unlabeled, otherwise the cluster number + 1
+    uint8_t labels[TOPOLOGY_NUM_CELLS] = {0};
+    uint8_t dfs_stack[TOPOLOGY_NUM_CELLS];
+    size_t num_clusters = 0;
+    size_t num_coords = 0;
+
+    // Sweep the board once in (q, r) order. Each cell that starts a trio seeds a cluster,
+    // and the DFS labels every hex connected to it, so later seeds skip those hexes.
+    // This finds the same clusters as repeatedly finding and matching the first cluster
+    // on the board.
+    if (!seeds) {
+        num_seeds = HEX_NUM_INDICES;
+    }
+    for (size_t s = 0; s < num_seeds; s++) {
+        const int index = seeds ? seeds[s] : (int)s;
+        if (!g_topology.is_valid[index]) {
+            continue;
+        }
+        int n1 = 0;
+        int n2 = 0;
+        if (!find_trio(board, game, index, labels, true, &n1, &n2)) {
+            continue;
+        }
+        ASSERT(num_clusters < max_clusters);
+        ASSERT(num_clusters < UINT8_MAX);
+
+        const uint8_t label = num_clusters + 1;
+        const HexType target_type = cell_at(board, game, index)->type;
+        HexCluster* cluster = &clusters[num_clusters++];
+        *cluster = (HexCluster){
+            .type = target_type,
+            .num_coords = 0,
+            .coords = &coords[num_coords],
+        };
+
+        size_t stack_size = 0;
+        dfs_stack[stack_size++] = index;
+        dfs_stack[stack_size++] = n1;
+        dfs_stack[stack_size++] = n2;
+        labels[index] = labels[n1] = labels[n2] = label;
+
+        while (stack_size > 0) {
+            const int c = dfs_stack[--stack_size];
+            ASSERT(num_coords < max_coords);
+            coords[num_coords++] = g_topology.coords[c];
+            cluster->num_coords++;
+
+            // Add neighbors to cluster if they meet all criteria:
+            //   1. Valid, stationary and not already matched
+            //   2. Not already in this or an earlier cluster
+            //   3. Type matches
+            //   4. Prior or next neighbor type matches and in cluster
+            //
+            // Invalid neighbors are the sentinel, which fails all criteria.
+            const uint8_t* neighbors = g_topology.neighbors[c];
+            for (int i = 0; i < MAX_NUM_HEX_NEIGHBORS; i++) {
+                const int i1 = neighbors[(i + MAX_NUM_HEX_NEIGHBORS - 1) % MAX_NUM_HEX_NEIGHBORS];
+                const int i2 = neighbors[i];
+                const int i3 = neighbors[(i + 1) % MAX_NUM_HEX_NEIGHBORS];
+
+                // Check criteria of the middle neighbor
+                if (!hex_is_unlabeled(board, game, i2, labels, true)) {
+                    continue;
+                }
+                if (cell_at(board, game, i2)->type != target_type) {
+                    continue;
                 }
-            }
 
-            if (vector_size(hex_coords) >= 3) {
-                // Stop at the first cluster found
-                goto done;
+                // Check prior neighbor, then next neighbor
+                if ((labels[i1] == label && cell_at(board, game, i1)->type == target_type) ||
+                    (labels[i3] == label && cell_at(board, game, i3)->type == target_type)) {
+                    dfs_stack[stack_size++] = i2;
+                    labels[i2] = label;
+                }
             }
         }
     }
 
-done:
-    vector_destroy(dfs_stack);
+    return num_clusters;
+}
 
-    if (vector_size(hex_coords) < 3) {
-        // Runt cluster doesn't count
-        vector_clear(hex_coords);
+size_t hex_find_all_simple_clusters(Game* game,
+        HexCluster* clusters, size_t max_clusters, HexCoord* coords, size_t max_coords) {
+    return find_all_simple_clusters(NULL, game, NULL, 0, clusters, max_clusters, coords, max_coords);
+}
+
+size_t hex_find_simple_clusters_at(Game* game, const uint8_t* seeds, size_t num_seeds,
+        HexCluster* clusters, size_t max_clusters, HexCoord* coords, size_t max_coords) {
+    return find_all_simple_clusters(NULL, game, seeds, num_seeds, clusters, max_clusters, coords, max_coords);
+}
+
+void hex_board_from_game(HexBoard* board, Game* game) {
+    for (int index = 0; index < HEX_NUM_INDICES; index++) {
+        board->cells[index] = g_topology.is_valid[index] ? *hex_at_index(game, index) : _sentinel_hex;
     }
-    return vector_size(hex_coords);
+    board->cells[TOPOLOGY_SENTINEL] = _sentinel_hex;
+}
+
+bool hex_board_has_cluster_match(const HexBoard* board, int index, bool require_stationary) {
+    int i1 = 0;
+    int i2 = 0;
+    return g_topology.is_valid[index] && find_trio(board, NULL, index, NULL, require_stationary, &i1, &i2);
+}
+
+bool hex_board_has_flower_match(const HexBoard* board, int index, bool require_stationary) {
+    return flower_match(board, NULL, index, require_stationary);
+}
+
+size_t hex_board_find_all_simple_clusters(const HexBoard* board,
+        HexCluster* clusters, size_t max_clusters, HexCoord* coords, size_t max_coords) {
+    return find_all_simple_clusters(board, NULL, NULL, 0, clusters, max_clusters, coords, max_coords);
 }
 
 size_t hex_find_one_bomb_cluster(Vector hex_coords) {
@@ -409,54 +624,115 @@ bool hex_is_starflower(const Hex* hex) {
     return (hex->type == HEX_TYPE_STARFLOWER);
 }
 
-Rectangle hex_bounding_box_of_coords(const HexCoord* coords, size_t num_coords) {
+double hex_fall_distance(double gravity, double frames) {
+    if (gravity <= 0.0 || frames <= 0.0) {
+        return 0.0;
+    }
+    // Speed is n * gravity in frame n, until it reaches the maximum in frame ramp_frames
+    const double ramp_frames = floor(HEX_MAX_FALL_SPEED / gravity);
+    const double n = floor(frames);
+    const double fraction = frames - n;
+    if (n < ramp_frames) {
+        return gravity * n * (n + 1.0) / 2.0 + fraction * gravity * (n + 1.0);
+    }
+    return gravity * ramp_frames * (ramp_frames + 1.0) / 2.0 +
+        (frames - ramp_frames) * HEX_MAX_FALL_SPEED;
+}
+
+uint32_t hex_fall_frames(double gravity, double distance) {
+    if (distance <= 0.0) {
+        return 1;
+    }
+    const double ramp_frames = floor(HEX_MAX_FALL_SPEED / gravity);
+    const double ramp_distance = hex_fall_distance(gravity, ramp_frames);
+    double n = (distance <= ramp_distance) ?
+        ceil((sqrt(1.0 + 8.0 * distance / gravity) - 1.0) / 2.0) :
+        ramp_frames + ceil((distance - ramp_distance) / HEX_MAX_FALL_SPEED);
+
+    // Correct for rounding in the closed forms
+    n = MAX(n, 1.0);
+    while (n > 1.0 && hex_fall_distance(gravity, n - 1.0) >= distance) {
+        n--;
+    }
+    while (hex_fall_distance(gravity, n) < distance) {
+        n++;
+    }
+    return (uint32_t)n;
+}
+
+Point hex_position(Game* game, int q, int r, double frame) {
+    Point point = transform_hex_to_screen(q, r);
+    const HexMotion* motion = hex_motion_at(game, q, r);
+    const double fall = hex_fall_distance(motion->gravity, frame - (double)motion->gravity_start_time);
+    point.y = MIN(point.y, (float)(motion->fall_start_y + fall));
+    return point;
+}
+
+Rectangle hex_bounding_box_of_coords(Game* game, const HexCoord* coords, size_t num_coords) {
     Rectangle r = {
         .top_left = {LOGICAL_WINDOW_WIDTH, LOGICAL_WINDOW_HEIGHT},
         .bottom_right = {0,0},
     };
     for (size_t i = 0; i < num_coords; i++) {
         HexCoord c = coords[i];
-        const Hex* hex = hex_at(c.q, c.r);
-        r.top_left.x = MIN(r.top_left.x, hex->hex_point.x);
-        r.top_left.y = MIN(r.top_left.y, hex->hex_point.y);
-        r.bottom_right.x = MAX(r.bottom_right.x, hex->hex_point.x + HEX_WIDTH);
-        r.bottom_right.y = MAX(r.bottom_right.y, hex->hex_point.y + HEX_HEIGHT);
+        const Point p = transform_hex_to_screen(c.q, c.r);
+        r.top_left.x = MIN(r.top_left.x, p.x);
+        r.top_left.y = MIN(r.top_left.y, p.y);
+        r.bottom_right.x = MAX(r.bottom_right.x, p.x + HEX_WIDTH);
+        r.bottom_right.y = MAX(r.bottom_right.y, p.y + HEX_HEIGHT);
     }
     r.width = r.bottom_right.x - r.top_left.x;
     r.height = r.bottom_right.y - r.top_left.y;
     return r;
 }
 
-void hex_print(const Hex* hex) {
-    SDL_Log("        is_valid: %d", hex->is_valid);
-    SDL_Log("            type: %d", hex->type);
-    SDL_Log("       hex_point: (%f,%f)", hex->hex_point.x, hex->hex_point.y);
-    SDL_Log("        velocity: %f", hex->velocity);
-    SDL_Log("   gravity_start: %u", (uint32_t)hex->gravity_start_time);
-    SDL_Log("   is_stationary: %d", hex->is_stationary);
-    SDL_Log("  is_flower_fade: %d", hex->flower_match_animation.in_progress);
-    SDL_Log("   is_match_anim: %d", hex->cluster_match_animation.in_progress);
-    SDL_Log("           scale: %f", hex->scale);
-    SDL_Log("           alpha: %f", hex->alpha);
-    SDL_Log("       rot_angle: %f", hex->rotation_angle);
-    SDL_Log("      is_matched: %d", hex->is_matched);
+void hex_print(Game* game, int q, int r) {
+    const Hex* hex = hex_at(game, q, r);
+    const HexMotion* motion = hex_motion_at(game, q, r);
+    const HexAnimation* animation = hex_animation_at(game, q, r);
+    LOG("        is_valid: %d", hex->is_valid);
+    LOG("            type: %d", hex->type);
+    LOG("    fall_start_y: %f", motion->fall_start_y);
+    LOG("         gravity: %f", motion->gravity);
+    LOG("   gravity_start: %u", motion->gravity_start_time);
+    LOG("    landing_time: %u", motion->landing_time);
+    LOG("   is_stationary: %d", hex->is_stationary);
+    LOG(" match_animation: %d", animation->match_animation);
+    LOG("           scale: %f", animation->scale);
+    LOG("           alpha: %f", animation->alpha);
+    LOG("       rot_angle: %f", animation->rotation_angle);
+    LOG("      is_matched: %d", hex->is_matched);
 }
 
-bool hex_is_animating(const Hex* hex) {
-    return
-        hex->flower_match_animation.in_progress ||
-        hex->cluster_match_animation.in_progress ||
-        hex->is_rotating;
+bool hex_is_animating(Game* game, int q, int r) {
+    if (hex_at(game, q, r)->is_rotating) {
+        return true;
+    }
+    return hex_animation_at(game, q, r)->match_animation != HEX_MATCH_ANIMATION_NONE;
 }
 
-bool hex_all_stationary_no_animation(void) {
+// Full scan of what the activity counters track
+static void validate_activity_counters(Game* game) {
+    uint32_t num_falling = 0;
+    uint32_t num_animating = 0;
     for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-        for (int r = 0; r < HEX_NUM_ROWS; r++) {
-            const Hex* hex = hex_at(q,r);
-            if (!hex->is_stationary || hex_is_animating(hex)) {
-                return false;
-            }
+        const HexColumn* column = &game->columns[q];
+        for (size_t i = 0; i < column->size; i++) {
+            num_falling += !column->hexes[i].is_stationary;
+            num_animating += (column->animations[i].match_animation != HEX_MATCH_ANIMATION_NONE);
         }
     }
-    return true;
+    ASSERT(num_falling == game->num_falling_hexes);
+    ASSERT(num_animating == game->num_animating_hexes);
+    ASSERT((num_falling == 0) == (game->falling_columns == 0));
+}
+
+bool hex_all_stationary_no_animation(Game* game) {
+#ifdef VALIDATE_BOARD_ACTIVITY
+    validate_activity_counters(game);
+#endif
+    return
+        game->num_falling_hexes == 0 &&
+        game->num_animating_hexes == 0 &&
+        !game->rotation_animation.in_progress;
 }
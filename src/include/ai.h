@@ -0,0 +1,53 @@
+#pragma once
+
+#include "moves.h"
+#include "hex.h"
+#include "game.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Monte Carlo move search.
+//
+// Every move that matches something is scored by playing randomized rollouts from the
+// board: the move itself, then the cascade of matches as removed hexes are replaced by
+// random ones from above, then a few follow-up moves. Rollouts are spread across a pool
+// of worker threads, and the move with the best average rollout score wins.
+
+// Upper bound on threads used by a search, including the calling thread
+#define AI_MAX_THREADS 16
+
+typedef struct {
+    bool found; // false if no move on the board matches anything
+    Move move;
+    double expected_score; // average rollout score of move
+    uint32_t num_candidates; // moves that were rolled out
+    uint64_t num_rollouts; // over all candidates
+    uint32_t num_threads;
+    uint64_t elapsed_ns;
+} AiResult;
+
+// Start the worker threads. Falls back to searching on the calling thread only if
+// threads can't be created. The rollout streams of the threads are split from seed, e.g.
+// the game's seed, so the AI draws no randomness from anywhere else.
+bool ai_init(uint64_t seed);
+
+// Stop and join the worker threads
+void ai_close(void);
+
+// Number of threads available to a search, including the calling thread
+uint32_t ai_num_threads(void);
+
+// Search for the best move on board for budget_ms, using up to num_threads threads
+// (0 for all of them). Blocks until the budget has been spent.
+// The worker threads run one search at a time, so only one thread may call this.
+// If no rollout finished within the budget, the move that scores the most by itself is
+// chosen. Returns result->found.
+bool ai_best_move(const HexBoard* board, uint32_t level, uint32_t budget_ms, uint32_t num_threads, AiResult* result);
+
+// Rollouts per second per thread of a finished search
+double ai_rollouts_per_sec_per_thread(const AiResult* result);
+
+// Called once per frame. While state->autoplay is set, searches for a move whenever the
+// board is at rest, then presses the cursor and rotate keys in state->input, one per frame,
+// as if they were typed on the keyboard. Plays one game at a time.
+void ai_autoplay_update(GameState* state);
@@ -1,5 +1,10 @@
+#pragma once
+
 #include <stdbool.h>
 
+// Defined in game.h
+typedef struct Game Game;
+
 typedef enum {
     AUDIO_MOVE_CURSOR,
     AUDIO_STARFLOWER,
@@ -8,4 +13,7 @@ typedef enum {
 
 bool audio_init(void);
 void audio_play_sound_effect(AudioSoundEffect);
+
+// Play, then clear, the sound effects game requested this frame
+void audio_update(Game* game);
 void audio_play_pause_music(void);
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "game.h"
+
+// Micro-benchmarks, run against the board of game.
+// Results are printed to the log.
+
+// Compare match query time of each MatchKernel, and cross-check their results.
+void benchmark_match_kernels(Game* game);
+
+// Time evaluating every legal move on the current board.
+void benchmark_moves(Game* game);
+
+// Time building the moves index from scratch, updating it after one hex changes, and
+// querying it.
+void benchmark_moves_index(Game* game);
+
+// Rollout throughput of the AI search on the current board, for 1 thread up to all of them.
+void benchmark_ai(Game* game);
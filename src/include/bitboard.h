@@ -0,0 +1,67 @@
+#pragma once
+
+#include "hex.h"
+#include "constants.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bitboard representation of the board, used for fast match detection.
+//
+// Each mask has one bit per cell, at bit HEX_INDEX(q, r). Because the even-q layout
+// puts odd and even columns at different heights, a neighbor is a fixed bit shift
+// away within a column parity (e.g. top-right is +9 bits for odd columns, +10 bits
+// for even columns), so trio and flower detection for a whole board is a handful
+// of shifts and ANDs per hex type.
+//
+// The padding row at the bottom of each column is never set, which keeps shifts
+// from wrapping from one column into the next.
+
+typedef unsigned __int128 BitboardMask;
+
+typedef struct {
+    BitboardMask types[NUM_HEX_TYPES];
+    BitboardMask valid;
+    BitboardMask stationary;
+    BitboardMask matched;
+    BitboardMask flower_matched;
+} Bitboard;
+
+// Pre-compute column masks. Must be called before any other bitboard function.
+bool bitboard_init(void);
+
+// Build a bitboard from the board of game
+void bitboard_from_board(Bitboard* bitboard, Game* game);
+
+// Returns mask of cells whose neighbor_id neighbor is set in mask
+BitboardMask bitboard_neighbor_mask(BitboardMask mask, HexNeighborID neighbor_id);
+
+// Returns mask of cells that are part of at least one trio (3 mutually adjacent hexes
+// of the same type). Equivalent to calling hex_has_cluster_match() on every cell.
+BitboardMask bitboard_trio_cells(const Bitboard* bitboard, bool require_stationary);
+
+// Returns mask of cells that are the center of a flower match.
+// Equivalent to calling hex_has_flower_match() on every cell.
+BitboardMask bitboard_flower_centers(const Bitboard* bitboard, bool require_stationary);
+
+bool bitboard_has_any_matches(const Bitboard* bitboard, bool require_stationary);
+
+// Same as hex_find_one_flower(), using the bitboard to locate the flower center.
+// Only cells in centers are considered as flower centers.
+size_t bitboard_find_one_flower(const Bitboard* bitboard, BitboardMask centers, Vector hex_coords);
+
+// Refresh the cell at (q,r) from the board of game, after the hex there changed
+void bitboard_update_cell(Bitboard* bitboard, Game* game, int q, int r);
+
+bool bitboard_test(BitboardMask mask, int q, int r);
+void bitboard_set(BitboardMask* mask, int q, int r);
+
+// Returns mask of every cell on the board (including the invalid bottom row of even columns)
+BitboardMask bitboard_all_cells(void);
+
+// Returns mask with every cell in mask and all of their neighbors
+BitboardMask bitboard_dilate(BitboardMask mask);
+
+int bitboard_count(BitboardMask mask);
+
+// Returns the index of the lowest set bit, or -1 if mask is empty
+int bitboard_first(BitboardMask mask);
@@ -23,6 +23,7 @@
 
 #include <stdbool.h>
 #include <stdlib.h>
+#include <stdint.h>
 
 /// Allocator that simply keeps track of an offset within a user-provided block of memory.
 /// Allocation is O(1), and consists of simply incrementing an offset.
@@ -33,11 +34,24 @@
 /// This can be useful as temporary dynamic storage during a single iteration of the game loop
 /// (i.e. call bump_allocator_free_all() at the end of each game loop iteration).
 ///
+/// Each BumpAllocator is independent, so every game can own one.
+///
 /// Reference: https://www.gingerbill.org/article/2019/02/08/memory-allocation-strategies-002/
 
-void bump_allocator_init(void* backing_buffer, size_t backing_buffer_size);
-void* bump_allocator_alloc(size_t size);
-void bump_allocator_free(void*);  // does nothing
-void bump_allocator_free_all(void);
-void bump_allocator_deinit(void);
-size_t bump_allocator_num_allocations(void);
+typedef struct {
+    uint8_t* buffer;
+    size_t buffer_size;
+    size_t offset;
+    size_t num_allocations;
+} BumpAllocator;
+
+void bump_allocator_init(BumpAllocator* allocator, void* backing_buffer, size_t backing_buffer_size);
+void* bump_allocator_alloc(BumpAllocator* allocator, size_t size);
+void bump_allocator_free(BumpAllocator* allocator, void*);  // does nothing
+void bump_allocator_free_all(BumpAllocator* allocator);
+void bump_allocator_deinit(BumpAllocator* allocator);
+size_t bump_allocator_num_allocations(const BumpAllocator* allocator);
+
+/// AllocFn and FreeFn for vector_create_with_allocator(), with a BumpAllocator* as the allocator.
+void* bump_allocator_vector_alloc(void* allocator, size_t size);
+void bump_allocator_vector_free(void* allocator, void* ptr);
@@ -3,9 +3,24 @@
 #include "point.h"
 #include <stdbool.h>
 
+#if 0 // 1080p
+#define LOGICAL_WINDOW_WIDTH 1920
+#define LOGICAL_WINDOW_HEIGHT 1080
+#else
+#define LOGICAL_WINDOW_WIDTH 1280
+#define LOGICAL_WINDOW_HEIGHT 720
+#endif
+
 #define HEX_NUM_COLUMNS 10
 #define HEX_NUM_ROWS 9
 
+// Flat cell index, used by bitboards and lookup tables.
+// Each column is padded with one extra row, so stepping off the top or bottom
+// of a column lands on an always-empty padding cell instead of the next column.
+#define HEX_INDEX_STRIDE (HEX_NUM_ROWS + 1)
+#define HEX_NUM_INDICES (HEX_NUM_COLUMNS * HEX_INDEX_STRIDE)
+#define HEX_INDEX(q, r) ((q) * HEX_INDEX_STRIDE + (r))
+
 typedef struct {
     double hex_s; // hex radius
     double hex_h; // hex height
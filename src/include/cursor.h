@@ -21,16 +21,20 @@ typedef struct {
 
 void cursor_init(Cursor* cursor);
 
-// Return true if cursor was moved
-bool cursor_up(Cursor* cursor);
-bool cursor_down(Cursor* cursor);
-bool cursor_left(Cursor* cursor);
-bool cursor_right(Cursor* cursor);
+// Put cursor at position of anchor, e.g. to show where a move is
+void cursor_set(Cursor* cursor, HexCoord anchor, CursorPos position);
+
+// Return true if cursor was moved.
+// The cursor stops on starflowers and black pearls of game's board.
+bool cursor_up(Game* game, Cursor* cursor);
+bool cursor_down(Game* game, Cursor* cursor);
+bool cursor_left(Game* game, Cursor* cursor);
+bool cursor_right(Game* game, Cursor* cursor);
 
 // Get the hex neighbors of the cursor.
-void cursor_neighbors(const Cursor* cursor, HexNeighbors* neighbors);
+void cursor_neighbors(Game* game, const Cursor* cursor, HexNeighbors* neighbors);
 
 // Returns true if query_hex_coord is under the cursor
-bool cursor_contains_hex(const Cursor* cursor, HexCoord query_hex_coord);
+bool cursor_contains_hex(Game* game, const Cursor* cursor, HexCoord query_hex_coord);
 
-void cursor_print(void);
+void cursor_print(const Cursor* cursor);
@@ -1,26 +1,39 @@
 #pragma once
 
-#include "text.h"
 #include "vector.h"
 #include "hex.h"
 #include "constants.h"
-#include <SDL.h>
+#include "bitboard.h"
+#include "rng.h"
+#include "audio.h"
+#include "tween.h"
 #include <stdbool.h>
 #include <stdint.h>
 
+// Defined in game_state.h
+typedef struct GameState GameState;
+
+// Most local score animations that can be shown at once. Any more are not shown.
+#define MAX_LOCAL_SCORE_ANIMATIONS 32
+
 typedef struct {
-    // Managed by game
+    // Managed by game, alpha and current_point are tweened
     bool in_progress;
-    uint32_t start_time;
     uint32_t score;
     double alpha; // range [0.0, 1.0]
     Point start_point;
     Point current_point;
-
-    // Managed by graphics
-    Text text;
 } LocalScoreAnimation;
 
+// Implementation used to answer match queries.
+// The reference kernel walks the board with hex_has_cluster_match() and hex_has_flower_match(),
+// the bitboard kernel uses bitwise operations on a Bitboard built from the board.
+typedef enum {
+    MATCH_KERNEL_BITBOARD,
+    MATCH_KERNEL_REFERENCE,
+    NUM_MATCH_KERNELS,
+} MatchKernel;
+
 typedef struct {
     bool in_progress;
     uint32_t start_time;
@@ -30,21 +43,72 @@ typedef struct {
     uint32_t rotation_count;
 } RotationAnimation;
 
-typedef struct {
+typedef struct Game {
     uint32_t seed;
+    Rng rng; // seeded from seed, the only source of randomness in the game
     uint32_t level;
     uint32_t combos_remaining;
     uint32_t score;
-    double gravity;
+    double gravity; // of hexes that start falling, see HexMotion
+
+    // Columns with hexes that haven't landed, and the first frame one of them lands
+    uint32_t falling_columns;
+    uint32_t next_landing_time;
+
+    // Board activity, updated as hexes start and stop falling and animating, so checking
+    // whether the board is at rest doesn't scan it. See hex_all_stationary_no_animation().
+    uint32_t num_falling_hexes; // valid hexes that aren't stationary
+    uint32_t num_animating_hexes; // hexes in a match animation
 
-    // Each column is Vector containing type Hex.
-    // The vector represents the stack of hexes on the board
-    // (i.e. vector index 0 is the bottom of the stack/board).
-    Vector hexes[HEX_NUM_COLUMNS];
+    // Each column represents the stack of hexes on the board
+    // (i.e. index 0 is the bottom of the stack/board).
+    HexColumn columns[HEX_NUM_COLUMNS];
+
+    // Cells that may have formed a new match since the last call to check_for_matches():
+    // rotated, landed, or released from a flower match. Only triangles and flowers
+    // touching these cells are re-evaluated.
+    BitboardMask dirty_cells;
 
     RotationAnimation rotation_animation;
-    Vector local_score_animations; // contains LocalScoreAnimation
+    LocalScoreAnimation local_score_animations[MAX_LOCAL_SCORE_ANIMATIONS];
+
+    // Every running animation
+    TweenPool tweens;
+
+    // Bit per AudioSoundEffect. The game only requests sounds, so it runs without an
+    // audio device. Played and cleared by audio_update().
+    uint32_t pending_sound_effects;
 } Game;
 
-bool game_init(void);
-bool game_update(void);
+// Start a new game in state, seeded from the clock
+bool game_init(GameState* state);
+
+// Start a new game in state. The same seed and inputs always replay the same game.
+//
+// Games share nothing but the read-only tables built by constants_init(), topology_init(),
+// bitboard_init() and tween_init(), so any number of them can be updated at once from different threads.
+bool game_init_with_seed(GameState* state, uint32_t seed);
+
+// Free what game_init_with_seed() allocated
+void game_deinit(GameState* state);
+
+// Advance state by one frame. Returns false if the game is suspended or throttled.
+bool game_update(GameState* state);
+
+// Returns true if game_update() would leave the game as it is, apart from the frame
+// count, until there is new input: the game is suspended, or the board is at rest with
+// nothing animating and the moves index is up to date.
+bool game_is_idle(GameState* state);
+
+// Returns true if there is a trio or flower match anywhere on the board
+bool game_has_any_matches(Game* game, MatchKernel kernel, bool require_stationary);
+
+const char* game_match_kernel_name(MatchKernel kernel);
+
+// Points awarded for matches, as added to Game::score
+uint32_t game_simple_cluster_score(HexType type, size_t num_coords, uint32_t level);
+uint32_t game_flower_score(HexType center_type, const HexType neighbor_types[6], uint32_t level);
+
+// Called by ASSERT(). Logs the failure, then prints and suspends the game last initialized
+// or updated on the calling thread, if any.
+void game_assert_failed(const char* file, int line);
@@ -5,19 +5,33 @@
 #include "game.h"
 #include "cursor.h"
 #include "hex.h"
+#include "moves.h"
+#include "bump_allocator.h"
 
-typedef struct {
+// Everything one game needs. Each GameState is independent, see game_init_with_seed().
+typedef struct GameState {
     uint32_t frame_count;
     uint32_t slow_mode_throttle;
     bool suspend_game;
     bool slow_mode;
     bool running;
+    bool autoplay;
+    bool show_hint;
+    MatchKernel match_kernel;
     Input input;
+    Input update_input; // input read by the last game_update(), for replays
     Game game;
     Cursor cursor;
 
-    // Backing buffer for bump_allocator. Reset on each game loop iteration.
+    // Which moves match on the board, updated whenever it comes to rest after a change
+    MovesIndex moves_index;
+    BitboardMask moves_index_dirty_cells; // cells changed since the last update
+    uint32_t num_reshuffles;
+
+    // Cells re-examined by match detection in the last game_update()
+    uint32_t match_cells_examined;
+
+    // Scratch memory for a single game_update(). Reset on each game loop iteration.
+    BumpAllocator temporary_allocator;
     uint8_t temporary_allocations[0x10000];
 } GameState;
-
-extern GameState g_state;
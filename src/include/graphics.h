@@ -4,7 +4,14 @@
 #include <SDL_ttf.h>
 #include <stdbool.h>
 #include "text.h"
+#include "game_state.h"
 
-bool graphics_init(void);
-void graphics_update(void);
+bool graphics_init(GameState* state);
+// Draws the game part way between its state before the last game_update() and its
+// current state. interpolation is the fraction of the way, in [0, 1].
+void graphics_update(GameState* state, double interpolation);
 void graphics_flip(void);
+
+// Redraw everything on the next graphics_update(), e.g. after the renderer lost the
+// contents of its render targets
+void graphics_invalidate(void);
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "point.h"
+#include "constants.h"
 #include "vector.h"
+#include "rng.h"
 #include <stdbool.h>
 #include <stdlib.h>
 #include <stdint.h>
 
+// Defined in game.h. Functions that read or change the board take the Game it belongs to.
+typedef struct Game Game;
+
 #if 0 // 1080p
 // Source png is 60 x 52, scaling up by 1.75
 #define HEX_WIDTH 105
@@ -15,6 +20,9 @@
 #define HEX_HEIGHT 52
 #endif
 
+// Fastest a hex falls, in pixels per frame
+#define HEX_MAX_FALL_SPEED 50
+
 // Bitmask to select specific hex neighbors in the bottom 6 bits.
 // Bit index corresponds to HexNeighborID (e.g. bit 0 is top, bit 1 is top right, etc).
 #define ALL_NEIGHBORS              0x3F
@@ -62,45 +70,80 @@ typedef struct {
 } HexNeighbors;
 
 typedef struct {
-    bool in_progress;
-    uint32_t start_time;
-    Point flower_center;
-    bool is_center;
-} FlowerMatchAnimation;
+    HexType type;
+    size_t num_coords;
+    HexCoord* coords;
+} HexCluster;
 
+typedef enum {
+    HEX_MATCH_ANIMATION_NONE,
+    HEX_MATCH_ANIMATION_CLUSTER,
+    HEX_MATCH_ANIMATION_FLOWER,
+} HexMatchAnimation;
+
+// The board is stored as parallel arrays, one entry per hex in each:
+//   Hex           - type and state flags, read by matching every frame
+//   HexMotion     - fall trajectory, used by the gravity system
+//   HexAnimation  - match animations and render transforms
+// Use hex_at(), hex_motion_at() and hex_animation_at() to access them.
 typedef struct {
-    bool in_progress;
-    uint32_t start_time;
-} ClusterMatchAnimation;
+    HexType type;
 
-typedef struct {
     bool is_valid; // TODO - do we even need this?
     bool is_dead;
+    bool is_stationary; // not falling, candidate for matching
+    bool is_rotating;
 
-    HexType type;
+    // True if the hex is combo'd in any way.
+    bool is_matched;
 
-    // Updated by gravity system
-    Point hex_point;
-    double velocity;
+    // True if the hex is part of a flower match
+    bool is_flower_matched;
+} Hex;
+
+// A hex falls from rest at fall_start_y, starting in the update of frame
+// gravity_start_time. It gains gravity pixels per frame of speed, up to
+// HEX_MAX_FALL_SPEED, and stops at its place on the board in the update of frame
+// landing_time. Its position in between is worked out by hex_position().
+typedef struct {
+    float fall_start_y;
+    float gravity;
     uint32_t gravity_start_time;
-    bool is_stationary; // not falling, candidate for matching
+    uint32_t landing_time;
+} HexMotion;
 
-    // Animations
-    FlowerMatchAnimation flower_match_animation;
-    ClusterMatchAnimation cluster_match_animation;
-    bool is_rotating;
+typedef struct {
+    // Match animation the hex is in, timed by tweens in Game::tweens
+    HexMatchAnimation match_animation;
+    Point flower_center; // for HEX_MATCH_ANIMATION_FLOWER
 
-    // Transformations, modified by animations
+    // Transformations, modified by tweens
     double scale;
     double alpha; // range [0.0, 1.0]
     double rotation_angle; // degrees
 
-    // True if the hex is combo'd in any way.
-    bool is_matched;
+    // Transformations before the update of frame tween_frame, for drawing in between
+    double prev_scale;
+    double prev_rotation_angle;
+    uint32_t tween_frame;
+} HexAnimation;
 
-    // True if the hex is part of a flower match
-    bool is_flower_matched;
-} Hex;
+// Flat copy of the hot hex state, indexed by HEX_INDEX(q, r). Cells that are not on the
+// board, and the extra entry at TOPOLOGY_SENTINEL, are invalid hexes.
+// Used to evaluate hypothetical boards without modifying the game.
+typedef struct {
+    Hex cells[HEX_NUM_INDICES + 1];
+} HexBoard;
+
+// Storage for one column of the board, in stack order (index 0 is the bottom row).
+// The arrays are parallel. Capacity is fixed: dead hexes are always erased before
+// their replacements are spawned, so a column never holds more than HEX_NUM_ROWS.
+typedef struct {
+    Hex hexes[HEX_NUM_ROWS];
+    HexMotion motion[HEX_NUM_ROWS];
+    HexAnimation animations[HEX_NUM_ROWS];
+    size_t size;
+} HexColumn;
 
 // Get coordinate of specific neighbor of hex at (q,r)
 HexCoord hex_neighbor_coord(int q, int r, HexNeighborID neighbor_id);
@@ -111,39 +154,100 @@ HexCoord hex_neighbor_coord(int q, int r, HexNeighborID neighbor_id);
 // Caller should check them with hex_coord_is_valid(q, r).
 void hex_neighbors(int q, int r, HexNeighbors* neighbors, uint8_t mask);
 
-// Spawn a random hex in column q.
+// Spawn a hex of the given type in column q.
 // Creates a new hex and pushes it to the top of the column stack.
 // Initial position is above the view port.
-Hex* hex_spawn(int q);
+// Returns the row of the new hex.
+int hex_spawn(Game* game, int q, HexType type);
+
+// Bitmask of the hex types spawned on a level. Bit index corresponds to HexType.
+uint32_t hex_level_type_mask(uint32_t level);
+
+// Generate a random, level-appropriate hex, using the game's Rng.
+HexType hex_random_type(Game* game);
+
+// Generate a random hex type from the types set in mask
+HexType hex_random_type_with_mask(Rng* rng, uint32_t mask);
+
+// Generate count random hex types from the types set in mask, in bulk.
+// Same distribution as hex_random_type_with_mask(), but not the same sequence.
+void hex_random_types(Rng* rng, uint32_t mask, HexType* types, size_t count);
+
+// Generate the types of a whole board with no trio or flower matches, in hex_spawn()
+// order: index q * HEX_NUM_ROWS + stack index. Cells are filled in one pass, each from
+// the types in mask that don't complete a match with the cells filled before it.
+// Returns false if some cell had no such type, leaving a match on the board. That
+// can't happen with 3 or more types.
+bool hex_random_match_free_types(Rng* rng, uint32_t mask, HexType* types);
+
+// hex_random_match_free_types() for num_boards boards, stored one after another.
+// Returns the number of boards that are match-free.
+size_t hex_random_match_free_boards(Rng* rng, uint32_t mask, HexType* types, size_t num_boards);
 
-// Generate a random, level-appropriate hex.
-HexType hex_random_type(void);
+Hex* hex_at(Game* game, int q, int r);
+HexMotion* hex_motion_at(Game* game, int q, int r);
+HexAnimation* hex_animation_at(Game* game, int q, int r);
 
-// Generate a random hex if hex is in the mask
-HexType hex_random_type_with_mask(uint32_t mask);
+// Whole-column arrays in stack order (index 0 is the bottom row, see hex_row_to_stack_index()).
+// Faster than calling hex_at() for every row in loops over the board.
+Hex* hex_column(Game* game, int q);
+HexMotion* hex_motion_column(Game* game, int q);
+HexAnimation* hex_animation_column(Game* game, int q);
 
-Hex* hex_at(int q, int r);
+// Removes hexes marked is_dead from column q, keeping the rest in stack order.
+// Survivors are moved down in place.
+void hex_erase_dead(Game* game, int q);
+
+// Hex at flat cell index HEX_INDEX(q, r).
+// Returns an invalid sentinel hex for TOPOLOGY_SENTINEL.
+const Hex* hex_at_index(Game* game, int index);
 
 // Returns true if the hex at (q,r) has a trio match.
 // If n1 and n2 are non-NULL and trio match found, populate with neighbor coords.
-bool hex_has_cluster_match(int q, int r, HexCoord* n1, HexCoord* n2, bool require_stationary);
+bool hex_has_cluster_match(Game* game, int q, int r, HexCoord* n1, HexCoord* n2, bool require_stationary);
 
 // Returns true if the hex at (q,r) has a flower match (all neighbors are the same type).
-bool hex_has_flower_match(int q, int r, bool require_stationary);
+bool hex_has_flower_match(Game* game, int q, int r, bool require_stationary);
+
+// Reference match query: returns true if there is any trio or flower match on the board.
+bool hex_has_any_matches(Game* game, bool require_stationary);
 
 // Find a single flower and add coordinates of center and neighbors to hex_coords.
 // The flower center will be in index 0, and the 6 neighbors will start at index 1.
 //
 // To be considered, a hex must have is_matched == false.
-size_t hex_find_one_flower(Vector hex_coords);
+size_t hex_find_one_flower(Game* game, Vector hex_coords);
+
+// Same as hex_find_one_flower(), only considering the num_centers cells in centers
+// (cell indices, in index order) as flower centers.
+size_t hex_find_one_flower_at(Game* game, const uint8_t* centers, size_t num_centers, Vector hex_coords);
 
-// Finds a single simple cluster (3, 4, or 5 of same hex type) and adds the coordinates of each
-// hex in the cluster to hex_coords.
+// Finds every simple cluster (3, 4, or 5 of same hex type) on the board in one sweep.
+// Each cluster's coordinates are written to coords, and clusters[i].coords points into it.
+// A hex belongs to at most one cluster, so coords needs room for one entry per cell and
+// clusters for one entry per three cells. Clusters are returned in board scan order.
 //
 // Multipliers can cluster without having to be the same color.
 //
 // To be considered, a hex must have is_matched == false.
-size_t hex_find_one_simple_cluster(Vector hex_coords);
+size_t hex_find_all_simple_clusters(Game* game,
+        HexCluster* clusters, size_t max_clusters, HexCoord* coords, size_t max_coords);
+
+// Same as hex_find_all_simple_clusters(), only seeding clusters at the num_seeds cells in
+// seeds (cell indices, in index order). Clusters still grow past the seeds. Finds the
+// same clusters as long as every trio on the board has a cell in seeds.
+size_t hex_find_simple_clusters_at(Game* game, const uint8_t* seeds, size_t num_seeds,
+        HexCluster* clusters, size_t max_clusters, HexCoord* coords, size_t max_coords);
+
+// Copy the board of game
+void hex_board_from_game(HexBoard* board, Game* game);
+
+// Same as hex_has_cluster_match(), hex_has_flower_match() and hex_find_all_simple_clusters(),
+// but for a HexBoard. Cells are identified by HEX_INDEX(q, r).
+bool hex_board_has_cluster_match(const HexBoard* board, int index, bool require_stationary);
+bool hex_board_has_flower_match(const HexBoard* board, int index, bool require_stationary);
+size_t hex_board_find_all_simple_clusters(const HexBoard* board,
+        HexCluster* clusters, size_t max_clusters, HexCoord* coords, size_t max_coords);
 
 // Finds bomb clusters (mix of a basic, bomb, and multipliers of a single color) and
 // adds the coordinates of each hex in the cluster to hex_coords.
@@ -159,8 +263,20 @@ size_t hex_find_one_mmc_cluster(Vector hex_coords);
 
 bool hex_coord_is_valid(HexCoord coord);
 
-// Given several coordinates, get the bounding box, in screen space
-Rectangle hex_bounding_box_of_coords(const HexCoord* coords, size_t num_coords);
+// Inverse of HEX_INDEX(q, r)
+HexCoord hex_index_to_coord(int index);
+
+// Distance a hex falls in its first frames of falling, which can be fractional
+double hex_fall_distance(double gravity, double frames);
+
+// Number of frames a hex takes to fall distance, at least 1
+uint32_t hex_fall_frames(double gravity, double distance);
+
+// Screen position of the hex at (q, r) after frame updates, which can be fractional
+Point hex_position(Game* game, int q, int r, double frame);
+
+// Given several coordinates of hexes at rest, get the bounding box, in screen space
+Rectangle hex_bounding_box_of_coords(Game* game, const HexCoord* coords, size_t num_coords);
 
 bool hex_is_basic(const Hex* hex);
 bool hex_is_multiplier(const Hex* hex);
@@ -168,13 +284,15 @@ bool hex_is_starflower(const Hex* hex);
 bool hex_is_bomb(const Hex* hex);
 bool hex_is_black_pearl(const Hex* hex);
 
-void hex_print(const Hex* hex);
+void hex_print(Game* game, int q, int r);
 Point transform_hex_to_screen(int q, int r);
 
 int hex_row_to_stack_index(int row);
 int hex_stack_index_to_row(int stack_index);
 
-bool hex_is_animating(const Hex* hex);
+bool hex_is_animating(Game* game, int q, int r);
 
-// Returns true if all hexes are stationary, not moving or animating.
-bool hex_all_stationary_no_animation(void);
+// Returns true if all hexes are stationary, not moving or animating. Reads the activity
+// counters in Game. Builds with VALIDATE_BOARD_ACTIVITY defined check them against a scan
+// of the board on every call.
+bool hex_all_stationary_no_animation(Game* game);
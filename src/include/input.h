@@ -1,6 +1,7 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 // X: rotate clockwise
 // Z: rotate counter-clockwise
@@ -9,6 +10,13 @@
 // Spacebar: suspend game
 // P: Print current board to console
 // L: slow mode (5 Hz)
+// K: toggle match kernel (bitboard/reference)
+// B: benchmark match kernels on current board
+// A: toggle autoplay
+// H: toggle move hint
+// While playing a replay:
+//   =/-: double/halve playback speed (1x to 64x)
+//   ]/[: skip forward/back one keyframe interval
 
 typedef struct {
     // Set on keypress, cleared by game when read
@@ -19,7 +27,22 @@ typedef struct {
     bool left;
     bool right;
     bool print_board;
+    bool run_benchmark;
+    bool toggle_hint;
+    bool replay_faster;
+    bool replay_slower;
+    bool replay_forward;
+    bool replay_back;
 } Input;
 
+// Defined in game_state.h
+typedef struct GameState GameState;
+
 bool input_init(void);
-void input_update(void);
+
+// Reads keyboard and window events into state
+void input_update(GameState* state);
+
+// Sleeps until an event arrives or timeout_ms passes, then reads events like
+// input_update(). Returns false if it timed out.
+bool input_wait(GameState* state, uint32_t timeout_ms);
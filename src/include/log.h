@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Logging for the core game logic, which builds without SDL.
+// Same usage as SDL_Log: printf-style format, one line per call.
+
+#define LOG(...) log_message(__VA_ARGS__)
+
+void log_message(const char* format, ...) __attribute__((format(printf, 1, 2)));
+
+// Disable logging, e.g. for long headless simulations
+void log_set_enabled(bool enabled);
@@ -1,8 +1,7 @@
 #pragma once
 
-#include "test_boards.h"
-#include "game_state.h"
-#include "cursor.h"
+#include "game.h"
+#include "log.h"
 #include <assert.h>
 
 #define MAX(a, b) \
@@ -19,13 +18,9 @@
         _a < _b ? _a : _b; \
     })
 
+#define ARRAY_SIZE(a) (sizeof(a) / sizeof((a)[0]))
+
 #define ASSERT(x) \
     if (!(x)) { \
-        SDL_Log( \
-            "\n\n----\n" \
-            "Assertion failed\n  %s:%d\n" \
-            "----", __FILE__, __LINE__); \
-        test_boards_print_current(); \
-        cursor_print(); \
-        g_state.suspend_game = true; \
+        game_assert_failed(__FILE__, __LINE__); \
     }
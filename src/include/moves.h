@@ -0,0 +1,90 @@
+#pragma once
+
+#include "hex.h"
+#include "cursor.h"
+#include "bitboard.h"
+#include "topology.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Legal move generation and outcome evaluation.
+//
+// A move is a cursor position plus a rotation direction, the same as moving the cursor
+// there and pressing a rotate key. Moves are evaluated on a HexBoard copy, so the game is
+// never modified. The board is expected to be at rest (every hex stationary, nothing
+// matched), which is the only time the game accepts a rotation.
+
+// Upper bound on the number of moves: every trio and every hex as a rotation center,
+// in both directions
+#define MOVES_MAX (2 * (TOPOLOGY_MAX_TRIANGLES + HEX_NUM_COLUMNS * HEX_NUM_ROWS))
+
+typedef struct {
+    HexCoord anchor;
+    CursorPos position; // CURSOR_POS_ON for starflower and black pearl rotations
+    bool clockwise;
+} Move;
+
+typedef struct {
+    Move move;
+    uint32_t num_rotations; // including automatic trio rotations
+    uint32_t score;
+    uint32_t num_flowers;
+    uint32_t num_clusters;
+    BitboardMask matched; // every hex matched by the move
+    BitboardMask flower_centers; // matched flower centers, which stay on the board
+} MoveOutcome;
+
+// Enumerate every legal move on the board. Returns the number of moves.
+size_t moves_generate(const HexBoard* board, Move* moves, size_t max_moves);
+
+// Apply move to a copy of board, including the automatic re-rotations handle_rotation()
+// does for trios, then resolve the matches the same way check_for_matches() does.
+// Returns true if the move matched anything.
+//
+// Cascades after the matched hexes are removed are not evaluated, since the hexes that
+// fall in are random.
+bool moves_evaluate(const HexBoard* board, Move move, uint32_t level, MoveOutcome* outcome);
+
+// Same as moves_evaluate(), but modifies board in place. Matched hexes are left on the
+// board with is_matched set, flower centers already changed to their new type.
+bool moves_apply(HexBoard* board, Move move, uint32_t level, MoveOutcome* outcome);
+
+// Find flowers, then simple clusters, among the unmatched hexes of board, in the same
+// order and with the same scoring as check_for_matches(). Matches are marked on board and
+// added to outcome. Returns true if anything new matched.
+bool moves_resolve_matches(HexBoard* board, uint32_t level, MoveOutcome* outcome);
+
+// Generate and evaluate every legal move. Returns the number of outcomes.
+size_t moves_evaluate_all(const HexBoard* board, uint32_t level, MoveOutcome* outcomes, size_t max_outcomes);
+
+// Which moves match, for a board at rest. A move only depends on the cells within two
+// hexes of the cells it rotates, so an update re-evaluates just the moves near cells
+// whose type changed since the last update.
+//
+// Moves are stored in slots: two per trio, in TopologyTriangle order, then two per cell
+// for starflower and black pearl rotations. Even slots are clockwise.
+#define MOVES_INDEX_NUM_SLOTS (2 * (TOPOLOGY_MAX_TRIANGLES + HEX_NUM_INDICES))
+#define MOVES_INDEX_NUM_WORDS ((MOVES_INDEX_NUM_SLOTS + 63) / 64)
+
+typedef struct {
+    HexBoard board; // types the index is up to date with, every valid cell at rest
+    bool is_built;
+    uint64_t matching[MOVES_INDEX_NUM_WORDS]; // bit per slot
+    uint32_t num_matching;
+    uint32_t num_evaluated; // moves evaluated by the last update
+} MovesIndex;
+
+// Forget the board, so the next update evaluates every move
+void moves_index_reset(MovesIndex* index);
+
+// Bring the index up to date with the types of board, which should be at rest
+void moves_index_update(MovesIndex* index, const HexBoard* board);
+
+// Whether any move matches. A board at rest with no matching moves is dead.
+bool moves_index_any(const MovesIndex* index);
+
+// Whether move matches. Moves that aren't legal never match.
+bool moves_index_matches(const MovesIndex* index, Move move);
+
+// The first matching move, in slot order. Returns false if there are none.
+bool moves_index_first(const MovesIndex* index, Move* move);
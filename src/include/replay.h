@@ -0,0 +1,108 @@
+#pragma once
+
+#include "game_state.h"
+#include "snapshot.h"
+#include "vector.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Replays: a game is recorded as its seed plus the gameplay keys read by each
+// game_update(), with a full-board keyframe every keyframe_interval frames.
+//
+// File layout:
+//   ReplayHeader
+//   Records, each starting with a tag byte:
+//     1-63:  input event. The tag is the key mask (REPLAY_KEY_*), followed by the frame
+//            as a varint delta from the previous record.
+//     0x40:  keyframe. Varint frame delta, then a GameSnapshot of ReplayHeader.keyframe_size
+//            bytes.
+//     0x41:  end of the recording. Varint frame delta.
+//     0x42:  delta keyframe. Varint frame delta, varint size, then that many bytes of
+//            snapshot delta from the previous keyframe.
+//
+// The header and keyframes are raw structs, so a recording only plays on builds with the
+// same keyframe_size. Records are flushed at every keyframe, so a recording cut short by
+// a crash can still be played up to its last complete record.
+//
+// Playback runs the recorded keys through game_update(), starting from the seed.
+// Seeking restores the closest keyframe before the target, so at most keyframe_interval
+// frames are simulated.
+
+#define REPLAY_VERSION 3
+
+// 1 minute at 60 Hz
+#define REPLAY_DEFAULT_KEYFRAME_INTERVAL 3600
+
+#define REPLAY_KEY_UP         0x01
+#define REPLAY_KEY_DOWN       0x02
+#define REPLAY_KEY_LEFT       0x04
+#define REPLAY_KEY_RIGHT      0x08
+#define REPLAY_KEY_ROTATE_CW  0x10
+#define REPLAY_KEY_ROTATE_CCW 0x20
+
+typedef struct {
+    char magic[4]; // "HXRP"
+    uint32_t version;
+    uint32_t keyframe_size; // sizeof(GameSnapshot) of the build that recorded it
+    uint32_t seed;
+    uint32_t start_frame; // frame_count when recording started
+    uint32_t keyframe_interval;
+} ReplayHeader;
+
+typedef struct {
+    uint32_t frame;
+    uint8_t keys;
+} ReplayEvent;
+
+typedef struct {
+    FILE* file;
+    uint32_t keyframe_interval;
+    uint32_t prev_frame; // frame of the last record written
+    uint64_t num_bytes;
+    GameSnapshot prev_keyframe; // base of the next delta keyframe
+} ReplayRecorder;
+
+typedef struct {
+    ReplayHeader header;
+    uint32_t end_frame;
+
+    Vector events; // ReplayEvent, in frame order
+    size_t next_event;
+
+    Vector keyframes; // GameSnapshot, in frame order
+    size_t next_keyframe;
+
+    // Keyframes passed during playback that didn't match the simulated game
+    uint32_t num_mismatches;
+} ReplayPlayer;
+
+// Start recording state to path. Writes a keyframe of the current state.
+bool replay_recorder_open(ReplayRecorder* recorder, const char* path, GameState* state, uint32_t keyframe_interval);
+
+// Record the keys read by the last game_update(). Call after each game_update() that
+// returned true, once frame_count has been incremented.
+void replay_recorder_update(ReplayRecorder* recorder, GameState* state);
+
+// Write the end record and close the file
+void replay_recorder_close(ReplayRecorder* recorder, const GameState* state);
+
+// Load a whole recording. Returns false if it can't be read or was recorded by an
+// incompatible build.
+bool replay_player_open(ReplayPlayer* player, const char* path);
+void replay_player_close(ReplayPlayer* player);
+
+// Start a new game in state from the recorded seed, or from the first keyframe if
+// recording started mid-game.
+bool replay_player_start(ReplayPlayer* player, GameState* state);
+
+// Move state to frame, restoring the closest keyframe at or before it. state must have
+// been started by replay_player_start().
+bool replay_player_seek(ReplayPlayer* player, GameState* state, uint32_t frame);
+
+// Play one frame: press the recorded keys, then game_update(). Keyframes reached are
+// checked against the simulated game. Returns false once the recording has ended or the
+// game stopped.
+bool replay_player_step(ReplayPlayer* player, GameState* state);
+
+bool replay_player_done(const ReplayPlayer* player, const GameState* state);
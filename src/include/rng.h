@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Pseudo-random number generator (xoshiro128**) with explicit state.
+//
+// Each Game owns one, seeded from Game::seed, so a game replays exactly from its seed.
+// Independent sequences for parallel simulations come from rng_split(): each split
+// jumps the parent ahead 2^64 outputs, so the streams never overlap in practice.
+
+typedef struct {
+    uint32_t s[4];
+} Rng;
+
+// Expand a 64-bit seed into a full state
+void rng_seed(Rng* rng, uint64_t seed);
+
+uint32_t rng_next(Rng* rng);
+
+// Uniform integer in [0, n). n must be non-zero.
+uint32_t rng_below(Rng* rng, uint32_t n);
+
+// Fill values with count consecutive outputs of rng_next()
+void rng_fill(Rng* rng, uint32_t* values, size_t count);
+
+// Returns a generator for an independent stream, and advances rng past it
+Rng rng_split(Rng* rng);
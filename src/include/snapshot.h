@@ -0,0 +1,42 @@
+#pragma once
+
+#include "game_state.h"
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Snapshots: a flat, pointer-free copy of everything game_update() reads that isn't
+// rebuilt from the seed. Taking or restoring one is a struct copy, so they can be used
+// for undo, rewind, speculative search and crash dumps.
+//
+// Consecutive snapshots mostly differ in a few hexes and counters, so they can be stored
+// as a delta: runs of changed 8 byte words, each encoded as
+//   varint number of unchanged words since the previous run
+//   varint number of changed words
+//   the changed words
+
+// Largest possible delta, when every other word changed
+#define SNAPSHOT_DELTA_MAX_SIZE (sizeof(GameSnapshot) + (sizeof(GameSnapshot) / 8 + 1) * 6)
+
+typedef struct {
+    uint32_t frame_count;
+    Cursor cursor;
+    Game game;
+} GameSnapshot;
+
+void snapshot_capture(GameSnapshot* snapshot, const GameState* state);
+
+// Restores the game and cursor. The moves index is rebuilt when the board is next at rest.
+void snapshot_restore(const GameSnapshot* snapshot, GameState* state);
+
+// Compares everything game_update() depends on. Padding and values that are only drawn
+// are ignored.
+bool snapshot_equal(const GameSnapshot* a, const GameSnapshot* b);
+
+// Encodes snapshot as a delta from base into delta, which must hold
+// SNAPSHOT_DELTA_MAX_SIZE bytes. Returns the size of the delta.
+size_t snapshot_delta_encode(const GameSnapshot* base, const GameSnapshot* snapshot, uint8_t* delta);
+
+// Applies a delta made by snapshot_delta_encode() to its base, in place. Returns false if
+// the delta is malformed, in which case snapshot is partially updated.
+bool snapshot_delta_apply(GameSnapshot* snapshot, const uint8_t* delta, size_t size);
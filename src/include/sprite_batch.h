@@ -0,0 +1,43 @@
+#pragma once
+
+#include <SDL.h>
+#include <stdbool.h>
+#include "window.h"
+
+// Sprite batches: textured quads queued in draw order and submitted together with one
+// SDL_RenderGeometry() call per run of sprites sharing a texture. Scale, rotation and
+// alpha are baked into each sprite's vertices, so they don't break up a batch the way
+// SDL_RenderCopyEx() and SDL_SetTextureAlphaMod() calls do.
+//
+// Anything drawn without the batch must be preceded by sprite_batch_flush() to keep the
+// draw order. Without SDL_RenderGeometry(), sprites are copied one by one as they're added.
+
+#define SPRITE_BATCH_MAX_SPRITES 128
+
+typedef struct {
+    SDL_Texture* texture; // of the queued sprites
+    int texture_width;
+    int texture_height;
+    int num_sprites;
+#ifdef USE_RENDER_GEOMETRY
+    SDL_Vertex vertices[SPRITE_BATCH_MAX_SPRITES * 4];
+    int indices[SPRITE_BATCH_MAX_SPRITES * 6];
+#endif
+} SpriteBatch;
+
+void sprite_batch_init(SpriteBatch* batch);
+
+// Queues src of texture to be drawn into dest, like SDL_RenderCopyEx(): rotated angle
+// degrees clockwise about center, which is relative to dest. alpha multiplies the
+// texture's alpha.
+void sprite_batch_add(
+        SpriteBatch* batch,
+        SDL_Texture* texture,
+        const SDL_Rect* src,
+        const SDL_FRect* dest,
+        double angle,
+        SDL_FPoint center,
+        Uint8 alpha);
+
+// Draws the queued sprites
+void sprite_batch_flush(SpriteBatch* batch);
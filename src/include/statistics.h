@@ -6,8 +6,14 @@ typedef struct {
     double render_ave_ns;
     double update_ave_ns;
     double loop_iter_ave_ns;
+
+    // Cells re-examined by match detection
+    uint32_t match_cells_last;
+    uint64_t match_cells_total;
+    double match_cells_ave;
 } Statistics;
 
 void statistics_update(uint64_t update_time_ns, uint64_t render_time_ns, uint64_t loop_iter_time_ns);
+void statistics_update_match_cells(uint32_t cells_examined);
 double statistics_fps(void);
 Statistics* statistics_get(void);
@@ -0,0 +1,49 @@
+#pragma once
+
+#include "hex.h"
+#include "constants.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+// Lookup tables describing the shape of the board, computed once at startup.
+//
+// Cells are identified by HEX_INDEX(q, r). Any neighbor that is off the board,
+// in a padding row, or in the invalid bottom row of an even column maps to
+// TOPOLOGY_SENTINEL. hex_at_index(TOPOLOGY_SENTINEL) is an invalid hex that never
+// matches anything, so table-driven code can read neighbors without bounds checks.
+
+#define TOPOLOGY_SENTINEL HEX_NUM_INDICES
+#define TOPOLOGY_NUM_CELLS (HEX_NUM_INDICES + 1) // including sentinel
+#define TOPOLOGY_MAX_TRIANGLES (2 * HEX_NUM_COLUMNS * HEX_NUM_ROWS)
+#define TOPOLOGY_NO_TRIANGLE 0xFF
+
+typedef struct {
+    // cells[0] is the anchor hex. cells[1] and cells[2] are the anchor neighbors
+    // selected by neighbor_mask, in HexNeighborID order (same as cursor_neighbors()).
+    uint8_t cells[3];
+    uint8_t neighbor_mask; // TRIO_RIGHT_NEIGHBORS or TRIO_LEFT_NEIGHBORS
+} TopologyTriangle;
+
+typedef struct {
+    HexCoord coords[TOPOLOGY_NUM_CELLS];
+    bool is_valid[TOPOLOGY_NUM_CELLS];
+
+    // Neighbor cell indices, in HexNeighborID order
+    uint8_t neighbors[TOPOLOGY_NUM_CELLS][MAX_NUM_HEX_NEIGHBORS];
+
+    // Every unique trio of mutually adjacent valid cells, each listed once
+    TopologyTriangle triangles[TOPOLOGY_MAX_TRIANGLES];
+    size_t num_triangles;
+
+    // For each cell, the triangle formed with neighbors i and i + 1 (clockwise),
+    // or TOPOLOGY_NO_TRIANGLE if one of those neighbors is invalid.
+    uint8_t cell_triangles[TOPOLOGY_NUM_CELLS][MAX_NUM_HEX_NEIGHBORS];
+
+    // Cells with six valid neighbors, in index order
+    uint8_t flower_centers[HEX_NUM_COLUMNS * HEX_NUM_ROWS];
+    size_t num_flower_centers;
+} Topology;
+
+bool topology_init(void);
+
+extern Topology g_topology;
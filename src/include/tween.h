@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Defined in game.h
+typedef struct Game Game;
+
+// Tweens: timed interpolations of one animated value, such as the scale of a hex.
+//
+// Every running tween lives in the game's TweenPool, packed at the front of a fixed
+// array, and tween_pool_update() advances them all in one loop. Nothing is scanned when
+// nothing is animating. The pool holds no pointers, so it is copied along with the
+// game by snapshots and replay keyframes.
+//
+// Hex tweens address their hex by column and stack index, which tween_pool_erase()
+// keeps up to date as hexes move down their column.
+
+#define TWEEN_POOL_SIZE 288
+
+// Samples per easing curve, see tween_init()
+#define TWEEN_EASING_TABLE_SIZE 64
+
+typedef enum {
+    TWEEN_EASING_LINEAR,
+    TWEEN_EASING_QUADRATIC_IN,
+    TWEEN_EASING_PULSE, // out to the end value at the halfway point, then back
+    NUM_TWEEN_EASINGS,
+} TweenEasing;
+
+typedef enum {
+    // HexAnimation of the hex at (q, index)
+    TWEEN_TARGET_HEX_TIMER, // no value, only finishes
+    TWEEN_TARGET_HEX_SCALE,
+    TWEEN_TARGET_HEX_ALPHA,
+    TWEEN_TARGET_HEX_ROTATION_ANGLE,
+
+    // Game::local_score_animations[index]
+    TWEEN_TARGET_LOCAL_SCORE_ALPHA,
+    TWEEN_TARGET_LOCAL_SCORE_Y,
+} TweenTarget;
+
+// What the game does once a tween has finished
+typedef enum {
+    TWEEN_DONE_NONE,
+    TWEEN_DONE_CLUSTER_MATCH,
+    TWEEN_DONE_FLOWER_PETAL,
+    TWEEN_DONE_FLOWER_CENTER,
+    TWEEN_DONE_LOCAL_SCORE,
+} TweenDone;
+
+typedef struct {
+    uint32_t start_time; // frame, may be in the future
+    uint16_t duration; // frames
+    uint8_t target; // TweenTarget
+    uint8_t easing; // TweenEasing
+    uint8_t done; // TweenDone
+    uint8_t q;
+    uint8_t index;
+    float from;
+    float to;
+} Tween;
+
+typedef struct {
+    uint32_t size;
+    Tween tweens[TWEEN_POOL_SIZE];
+} TweenPool;
+
+// Builds the easing tables
+bool tween_init(void);
+
+void tween_pool_clear(TweenPool* pool);
+
+void tween_pool_add(TweenPool* pool, const Tween* tween);
+
+// Writes the value of every started tween at frame now to its target. A tween finishes
+// on the first frame after its duration has passed, without writing a value. Finished
+// tweens are removed, and the ones with a done action are copied to finished, which must
+// hold TWEEN_POOL_SIZE tweens. Returns the number copied.
+uint32_t tween_pool_update(Game* game, uint32_t now, Tween* finished);
+
+// Call after hex_erase_dead() erased the hexes at the stack indices in the erased mask
+// from column q. Their tweens are removed, and the tweens of the hexes above them follow
+// them down.
+void tween_pool_erase(TweenPool* pool, int q, uint32_t erased);
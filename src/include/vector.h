@@ -27,8 +27,9 @@
 // Opaque handle to vector
 typedef struct _Vector* Vector;
 
-typedef void* (*AllocFn)(size_t);
-typedef void (*FreeFn)(void*);
+// The allocator passed to vector_create_with_allocator() is handed back to every call
+typedef void* (*AllocFn)(void* allocator, size_t size);
+typedef void (*FreeFn)(void* allocator, void* ptr);
 
 // Creates a new vector.
 //
@@ -38,7 +39,7 @@ typedef void (*FreeFn)(void*);
 Vector vector_create(size_t item_size);
 
 // Creates a vector with custom alloc and free functions.
-Vector vector_create_with_allocator(size_t item_size, AllocFn alloc_fn, FreeFn free_fn);
+Vector vector_create_with_allocator(size_t item_size, AllocFn alloc_fn, FreeFn free_fn, void* allocator);
 
 // Clone a vector.
 //
@@ -118,6 +119,7 @@ size_t vector_size(Vector);
 void vector_clear(Vector);
 
 // Erase all items in the vector where fn(item) return true.
+// Remaining items keep their order and are moved in place, no allocation is done.
 typedef bool (*VectorEraseFn)(const void* item);
 void vector_erase_if(Vector, VectorEraseFn fn);
 
@@ -1,14 +1,13 @@
 #pragma once
 
+#include "constants.h"
 #include <SDL.h>
 #include <stdbool.h>
 
-#if 0 // 1080p
-#define LOGICAL_WINDOW_WIDTH 1920
-#define LOGICAL_WINDOW_HEIGHT 1080
-#else
-#define LOGICAL_WINDOW_WIDTH 1280
-#define LOGICAL_WINDOW_HEIGHT 720
+// SDL_RenderGeometry() arrived in SDL 2.0.18. Without it, drawing falls back to copying
+// textures one at a time.
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+#define USE_RENDER_GEOMETRY
 #endif
 
 // Returns false if init fails
@@ -7,35 +7,69 @@ bool input_init(void) {
     return true;
 }
 
-void input_update(void) {
+static void handle_event(GameState* state, const SDL_Event* e) {
+    if (e->type == SDL_QUIT) {
+        state->running = false;
+    } else if (e->type == SDL_RENDER_TARGETS_RESET) {
+        graphics_invalidate();
+    } else if (e->type == SDL_KEYDOWN) {
+        if (e->key.keysym.sym == SDLK_x) {
+            state->input.rotate_cw = true;
+        } else if (e->key.keysym.sym == SDLK_z) {
+            state->input.rotate_ccw = true;
+        } else if (e->key.keysym.sym == SDLK_ESCAPE) {
+            state->running = false;
+        } else if (e->key.keysym.sym == SDLK_UP) {
+            state->input.up = true;
+        } else if (e->key.keysym.sym == SDLK_DOWN) {
+            state->input.down = true;
+        } else if (e->key.keysym.sym == SDLK_LEFT) {
+            state->input.left = true;
+        } else if (e->key.keysym.sym == SDLK_RIGHT) {
+            state->input.right = true;
+        } else if (e->key.keysym.sym == SDLK_p) {
+            state->input.print_board = true;
+        } else if (e->key.keysym.sym == SDLK_SPACE) {
+            state->suspend_game = !state->suspend_game;
+            SDL_Log("%s game", state->suspend_game ? "Suspending" : "Resuming");
+        } else if (e->key.keysym.sym == SDLK_l) {
+            state->slow_mode = !state->slow_mode;
+            SDL_Log("%s mode", state->slow_mode ? "Slow" : "Normal");
+        } else if (e->key.keysym.sym == SDLK_k) {
+            state->match_kernel = (state->match_kernel + 1) % NUM_MATCH_KERNELS;
+            SDL_Log("Using %s match kernel", game_match_kernel_name(state->match_kernel));
+        } else if (e->key.keysym.sym == SDLK_b) {
+            state->input.run_benchmark = true;
+        } else if (e->key.keysym.sym == SDLK_h) {
+            state->input.toggle_hint = true;
+        } else if (e->key.keysym.sym == SDLK_a) {
+            state->autoplay = !state->autoplay;
+            SDL_Log("Autoplay %s", state->autoplay ? "on" : "off");
+        } else if (e->key.keysym.sym == SDLK_EQUALS) {
+            state->input.replay_faster = true;
+        } else if (e->key.keysym.sym == SDLK_MINUS) {
+            state->input.replay_slower = true;
+        } else if (e->key.keysym.sym == SDLK_RIGHTBRACKET) {
+            state->input.replay_forward = true;
+        } else if (e->key.keysym.sym == SDLK_LEFTBRACKET) {
+            state->input.replay_back = true;
+        }
+    }
+}
+
+void input_update(GameState* state) {
     SDL_Event e;
     while (SDL_PollEvent(&e)) {
-        if (e.type == SDL_QUIT) {
-            g_state.running = false;
-        } else if (e.type == SDL_KEYDOWN) {
-            if (e.key.keysym.sym == SDLK_x) {
-                g_state.input.rotate_cw = true;
-            } else if (e.key.keysym.sym == SDLK_z) {
-                g_state.input.rotate_ccw = true;
-            } else if (e.key.keysym.sym == SDLK_ESCAPE) {
-                g_state.running = false;
-            } else if (e.key.keysym.sym == SDLK_UP) {
-                g_state.input.up = true;
-            } else if (e.key.keysym.sym == SDLK_DOWN) {
-                g_state.input.down = true;
-            } else if (e.key.keysym.sym == SDLK_LEFT) {
-                g_state.input.left = true;
-            } else if (e.key.keysym.sym == SDLK_RIGHT) {
-                g_state.input.right = true;
-            } else if (e.key.keysym.sym == SDLK_p) {
-                g_state.input.print_board = true;
-            } else if (e.key.keysym.sym == SDLK_SPACE) {
-                g_state.suspend_game = !g_state.suspend_game;
-                SDL_Log("%s game", g_state.suspend_game ? "Suspending" : "Resuming");
-            } else if (e.key.keysym.sym == SDLK_l) {
-                g_state.slow_mode = !g_state.slow_mode;
-                SDL_Log("%s mode", g_state.slow_mode ? "Slow" : "Normal");
-            }
-        }
+        handle_event(state, &e);
     }
 }
+
+bool input_wait(GameState* state, uint32_t timeout_ms) {
+    SDL_Event e;
+    if (!SDL_WaitEventTimeout(&e, (int)timeout_ms)) {
+        return false;
+    }
+    handle_event(state, &e);
+    input_update(state);
+    return true;
+}
@@ -0,0 +1,20 @@
+#include "log.h"
+#include <stdio.h>
+#include <stdarg.h>
+
+static bool _enabled = true;
+
+void log_message(const char* format, ...) {
+    if (!_enabled) {
+        return;
+    }
+    va_list args;
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+void log_set_enabled(bool enabled) {
+    _enabled = enabled;
+}
@@ -6,6 +6,14 @@
 #include "graphics.h"
 #include "audio.h"
 #include "bump_allocator.h"
+#include "bitboard.h"
+#include "topology.h"
+#include "tween.h"
+#include "ai.h"
+#include "replay.h"
+#include "macros.h"
+#include <stdlib.h>
+#include <string.h>
 #ifdef IS_WASM_BUILD
 #include <emscripten.h>
 #endif
@@ -14,55 +22,208 @@
 #define CLOSE_AND_RETURN_IF_FALSE(x) if ((x) == false) { window_close(); return 1; }
 
 // All game state data is stored in here
-GameState g_state = {0};
+static GameState _state = {0};
+
+// The game updates at a fixed 60 Hz, whatever the display rate. Each loop iteration runs
+// the updates that are due, then draws the game part way to the next one.
+#define UPDATE_INTERVAL_NS ((uint64_t)(MS_PER_FRAME * 1000000.0f))
+
+// After a stall, e.g. while the window is dragged, the game slows down instead of running
+// a burst of updates to catch up
+#define MAX_UPDATES_PER_LOOP 4
+
+static uint64_t _pending_update_ns = 0; // time not yet simulated
+static bool _last_update_ran = false;
+
+// While the game is idle every update and draw would be the same as the last, so the loop
+// draws it once and then sleeps until an event arrives. The timeout only bounds how long
+// a missed wakeup could go unnoticed.
+#define IDLE_WAIT_TIMEOUT_MS 500
+
+static bool _idle_drawn = false; // the idle game has been drawn since it became idle
+
+#define REPLAY_MAX_SPEED 64
+
+static ReplayRecorder _recorder = {0};
+static ReplayPlayer _player = {0};
+static bool _recording = false;
+static bool _playing = false;
+static uint32_t _replay_speed = 1;
+
+// Plays _replay_speed frames of the replay. Returns true if the game updated.
+static bool replay_update(GameState* state) {
+    Input* input = &state->input;
+    if (input->replay_faster || input->replay_slower) {
+        _replay_speed = input->replay_faster ? MIN(_replay_speed * 2, REPLAY_MAX_SPEED) : MAX(_replay_speed / 2, 1);
+        LOG("Replay speed %ux", _replay_speed);
+    }
+    if (input->replay_forward || input->replay_back) {
+        const uint32_t interval = _player.header.keyframe_interval;
+        const uint32_t frame = input->replay_forward ? state->frame_count + interval
+                                                     : state->frame_count - MIN(state->frame_count, interval);
+        replay_player_seek(&_player, state, frame);
+        LOG("Replay at frame %u of %u", state->frame_count, _player.end_frame);
+    }
+    input->replay_faster = input->replay_slower = false;
+    input->replay_forward = input->replay_back = false;
+
+    bool updated = false;
+    for (uint32_t i = 0; i < _replay_speed; i++) {
+        if (!replay_player_step(&_player, state)) {
+            break;
+        }
+        updated = true;
+        bump_allocator_free_all(&state->temporary_allocator);
+    }
+    return updated;
+}
+
+// -r file: record the game. -p file: play a recording. -x speed: playback speed.
+static bool parse_args(int argc, char* argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-r") == 0) {
+            _recording = replay_recorder_open(&_recorder, argv[i + 1], &_state, REPLAY_DEFAULT_KEYFRAME_INTERVAL);
+        } else if (strcmp(argv[i], "-p") == 0) {
+            _playing = replay_player_open(&_player, argv[i + 1]) && replay_player_start(&_player, &_state);
+            if (!_playing) {
+                return false;
+            }
+        } else if (strcmp(argv[i], "-x") == 0) {
+            const uint32_t speed = (uint32_t)strtoul(argv[i + 1], NULL, 10);
+            _replay_speed = MIN(MAX(speed, 1u), (uint32_t)REPLAY_MAX_SPEED);
+        }
+    }
+    return true;
+}
+
+// Runs one game update. Returns true if the game updated.
+static bool update(GameState* state) {
+    bool game_updated = false;
+    if (_playing) {
+        game_updated = replay_update(state);
+    } else {
+        ai_autoplay_update(state);
+        game_updated = game_update(state);
+    }
+    if (game_updated) {
+        statistics_update_match_cells(state->match_cells_examined);
+    }
+
+    bump_allocator_free_all(&state->temporary_allocator);
+
+    if (game_updated && !_playing) {
+        state->frame_count++;
+        if (_recording) {
+            replay_recorder_update(&_recorder, state);
+        }
+    }
+    return game_updated;
+}
+
+// Replays and autoplay make their own input, so they are never idle
+static bool is_idle(GameState* state) {
+    return !_playing && !state->autoplay && game_is_idle(state);
+}
+
+// Returns the time just before the flip, which waits for the display
+static uint64_t draw(GameState* state, double interpolation) {
+    audio_update(&state->game);
+    graphics_update(state, interpolation);
+    const uint64_t drawn = now_ns();
+    graphics_flip();
+    return drawn;
+}
 
 static void loop(void* arg) {
+    GameState* state = (GameState*)arg;
     static uint64_t prev_start = 0;
+
+    if (is_idle(state)) {
+        // Drawn at the end of the last update, not part way to the next one
+        if (!_idle_drawn) {
+            draw(state, 1.0);
+            _idle_drawn = true;
+        }
+#ifdef IS_WASM_BUILD
+        // The browser calls loop() on every display frame, so there's nothing to wait on
+        input_update(state);
+        if (is_idle(state)) {
+            return;
+        }
+#else
+        if (!input_wait(state, IDLE_WAIT_TIMEOUT_MS)) {
+            return;
+        }
+#endif
+        // Start updating again now, as if the game had just started, instead of catching
+        // up on the time spent idle
+        prev_start = 0;
+        _pending_update_ns = 0;
+    }
+    _idle_drawn = false;
+
     uint64_t start = now_ns();
 
+    const bool starting = (prev_start == 0);
     uint64_t loop_iter_diff = start - prev_start;
-    input_update();
-    bool game_updated = game_update();
-    graphics_update();
-    uint64_t update_diff = now_ns() - start;
-    graphics_flip();
-    uint64_t render_diff = now_ns() - start;
+    _pending_update_ns += starting ?
+        UPDATE_INTERVAL_NS :
+        MIN(loop_iter_diff, MAX_UPDATES_PER_LOOP * UPDATE_INTERVAL_NS);
 
-    if (g_state.frame_count != 0) {
-        statistics_update(update_diff, render_diff, loop_iter_diff);
+    input_update(state);
+    while (_pending_update_ns >= UPDATE_INTERVAL_NS) {
+        _pending_update_ns -= UPDATE_INTERVAL_NS;
+        _last_update_ran = update(state);
     }
-    prev_start = start;
 
-    bump_allocator_free_all();
+    // A game that didn't update last time, e.g. while suspended, is drawn as it is
+    const double interpolation = _last_update_ran ?
+        (double)_pending_update_ns / (double)UPDATE_INTERVAL_NS :
+        1.0;
+    uint64_t update_diff = draw(state, interpolation) - start;
+    uint64_t render_diff = now_ns() - start;
 
-    if (game_updated) {
-        g_state.frame_count++;
+    if (state->frame_count != 0 && !starting) {
+        statistics_update(update_diff, render_diff, loop_iter_diff);
     }
+    prev_start = start;
 }
 
 int main(int argc, char* argv[]) {
-    bump_allocator_init(g_state.temporary_allocations, sizeof(g_state.temporary_allocations));
     RETURN_IF_FALSE(window_init());
     RETURN_IF_FALSE(window_create());
 
     CLOSE_AND_RETURN_IF_FALSE(constants_init());
+    CLOSE_AND_RETURN_IF_FALSE(topology_init());
+    CLOSE_AND_RETURN_IF_FALSE(bitboard_init());
+    CLOSE_AND_RETURN_IF_FALSE(tween_init());
     CLOSE_AND_RETURN_IF_FALSE(input_init());
-    CLOSE_AND_RETURN_IF_FALSE(game_init());
-    CLOSE_AND_RETURN_IF_FALSE(graphics_init());
+    CLOSE_AND_RETURN_IF_FALSE(game_init(&_state));
+    CLOSE_AND_RETURN_IF_FALSE(parse_args(argc, argv));
+    CLOSE_AND_RETURN_IF_FALSE(graphics_init(&_state));
     CLOSE_AND_RETURN_IF_FALSE(audio_init());
+    CLOSE_AND_RETURN_IF_FALSE(ai_init(_state.game.seed));
     audio_play_pause_music();
 
 #ifdef IS_WASM_BUILD
     const int simulate_infinite_loop = 1;
-    const int fps = 60;
-    emscripten_set_main_loop_arg(loop, NULL, fps, simulate_infinite_loop);
+    const int fps = 0; // the browser's display rate, updates are paced by loop()
+    emscripten_set_main_loop_arg(loop, &_state, fps, simulate_infinite_loop);
 #else
-    g_state.running = true;
-    while (g_state.running) {
-        loop(NULL);
+    _state.running = true;
+    while (_state.running) {
+        loop(&_state);
     }
 #endif
 
+    ai_close();
+    if (_recording) {
+        replay_recorder_close(&_recorder, &_state);
+    }
+    if (_playing) {
+        replay_player_close(&_player);
+    }
+    game_deinit(&_state);
     window_close();
     return 0;
 }
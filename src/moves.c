@@ -0,0 +1,384 @@
+#include "moves.h"
+#include "game.h"
+#include "macros.h"
+#include <string.h>
+
+// Gets the cells rotated by move, in the order handle_rotation() passes them to rotate_hexes().
+// Returns 0 if the move is not legal on this board.
+static size_t move_cells(const HexBoard* board, Move move, uint8_t cells[MAX_NUM_HEX_NEIGHBORS]) {
+    if (!hex_coord_is_valid(move.anchor)) {
+        return 0;
+    }
+    const int anchor = HEX_INDEX(move.anchor.q, move.anchor.r);
+
+    // Same neighbors as cursor_neighbors()
+    uint8_t mask = 0;
+    size_t num_cells = 0;
+    if (move.position == CURSOR_POS_ON) {
+        const HexType type = board->cells[anchor].type;
+        if (type == HEX_TYPE_STARFLOWER) {
+            mask = ALL_NEIGHBORS;
+        } else if (type == HEX_TYPE_BLACK_PEARL_UP) {
+            mask = BLACK_PEARL_UP_NEIGHBORS;
+        } else if (type == HEX_TYPE_BLACK_PEARL_DOWN) {
+            mask = BLACK_PEARL_DOWN_NEIGHBORS;
+        } else {
+            return 0;
+        }
+    } else {
+        mask = (move.position == CURSOR_POS_LEFT) ? TRIO_LEFT_NEIGHBORS : TRIO_RIGHT_NEIGHBORS;
+        cells[num_cells++] = anchor;
+    }
+
+    for (int id = 0; id < MAX_NUM_HEX_NEIGHBORS; id++) {
+        if (mask & (1 << id)) {
+            const int n = g_topology.neighbors[anchor][id];
+            if (!g_topology.is_valid[n]) {
+                return 0;
+            }
+            cells[num_cells++] = n;
+        }
+    }
+    return num_cells;
+}
+
+// Same as rotate_hexes(), only the type moves
+static void rotate_cells(HexBoard* board, const uint8_t* cells, size_t num_cells, bool clockwise) {
+    if (clockwise) {
+        const HexType end_type = board->cells[cells[num_cells - 1]].type;
+        for (int i = num_cells - 2; i >= 0; i--) {
+            board->cells[cells[i + 1]].type = board->cells[cells[i]].type;
+        }
+        board->cells[cells[0]].type = end_type;
+    } else {
+        const HexType beginning_type = board->cells[cells[0]].type;
+        for (int i = 0; i < num_cells - 1; i++) {
+            board->cells[cells[i]].type = board->cells[cells[i + 1]].type;
+        }
+        board->cells[cells[num_cells - 1]].type = beginning_type;
+    }
+}
+
+// The board was at rest before the rotation, so any new match includes a rotated cell
+static bool rotated_cells_have_matches(const HexBoard* board, const uint8_t* cells, size_t num_cells) {
+    for (size_t i = 0; i < num_cells; i++) {
+        if (hex_board_has_cluster_match(board, cells[i], true)) {
+            return true;
+        }
+    }
+    for (size_t i = 0; i < num_cells; i++) {
+        if (hex_board_has_flower_match(board, cells[i], true)) {
+            return true;
+        }
+        const uint8_t* neighbors = g_topology.neighbors[cells[i]];
+        for (int id = 0; id < MAX_NUM_HEX_NEIGHBORS; id++) {
+            if (hex_board_has_flower_match(board, neighbors[id], true)) {
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+static void mark_matched(HexBoard* board, int index, bool is_flower, MoveOutcome* outcome) {
+    board->cells[index].is_matched = true;
+    board->cells[index].is_flower_matched |= is_flower;
+    const HexCoord c = g_topology.coords[index];
+    bitboard_set(&outcome->matched, c.q, c.r);
+}
+
+bool moves_resolve_matches(HexBoard* board, uint32_t level, MoveOutcome* outcome) {
+    const BitboardMask matched_before = outcome->matched;
+
+    // Flowers, one at a time, lowest cell index first
+    while (1) {
+        int center = -1;
+        for (size_t i = 0; i < g_topology.num_flower_centers; i++) {
+            if (hex_board_has_flower_match(board, g_topology.flower_centers[i], true)) {
+                center = g_topology.flower_centers[i];
+                break;
+            }
+        }
+        if (center < 0) {
+            break;
+        }
+
+        Hex* center_hex = &board->cells[center];
+        HexType neighbor_types[MAX_NUM_HEX_NEIGHBORS];
+        for (int id = 0; id < MAX_NUM_HEX_NEIGHBORS; id++) {
+            const int n = g_topology.neighbors[center][id];
+            neighbor_types[id] = board->cells[n].type;
+            mark_matched(board, n, true, outcome);
+        }
+        mark_matched(board, center, true, outcome);
+        bitboard_set(&outcome->flower_centers, g_topology.coords[center].q, g_topology.coords[center].r);
+        outcome->score += game_flower_score(center_hex->type, neighbor_types, level);
+        outcome->num_flowers++;
+
+        // Same new center type as handle_flower(). The game picks either black pearl at
+        // random, which doesn't change the score of this move.
+        const Hex petal = { .type = neighbor_types[0] };
+        if (hex_is_starflower(&petal)) {
+            center_hex->type = HEX_TYPE_BLACK_PEARL_UP;
+        } else if (!hex_is_black_pearl(&petal)) {
+            center_hex->type = HEX_TYPE_STARFLOWER;
+        }
+    }
+
+    // Simple clusters
+    HexCluster clusters[HEX_NUM_COLUMNS * HEX_NUM_ROWS / 3];
+    HexCoord coords[HEX_NUM_COLUMNS * HEX_NUM_ROWS];
+    const size_t num_clusters = hex_board_find_all_simple_clusters(
+            board, clusters, ARRAY_SIZE(clusters), coords, ARRAY_SIZE(coords));
+    for (size_t i = 0; i < num_clusters; i++) {
+        for (size_t j = 0; j < clusters[i].num_coords; j++) {
+            const HexCoord c = clusters[i].coords[j];
+            mark_matched(board, HEX_INDEX(c.q, c.r), false, outcome);
+        }
+        outcome->score += game_simple_cluster_score(clusters[i].type, clusters[i].num_coords, level);
+    }
+    outcome->num_clusters += num_clusters;
+    return outcome->matched != matched_before;
+}
+
+size_t moves_generate(const HexBoard* board, Move* moves, size_t max_moves) {
+    size_t num_moves = 0;
+
+    // Every trio is a cursor position to the left or right of its anchor hex
+    for (size_t t = 0; t < g_topology.num_triangles; t++) {
+        const TopologyTriangle* triangle = &g_topology.triangles[t];
+        const Move move = {
+            .anchor = g_topology.coords[triangle->cells[0]],
+            .position = (triangle->neighbor_mask == TRIO_LEFT_NEIGHBORS) ? CURSOR_POS_LEFT : CURSOR_POS_RIGHT,
+        };
+        ASSERT(num_moves + 2 <= max_moves);
+        moves[num_moves] = move;
+        moves[num_moves++].clockwise = true;
+        moves[num_moves] = move;
+        moves[num_moves++].clockwise = false;
+    }
+
+    // Starflowers and black pearls rotate their neighbors
+    for (int index = 0; index < HEX_NUM_INDICES; index++) {
+        uint8_t cells[MAX_NUM_HEX_NEIGHBORS];
+        const Move move = {
+            .anchor = g_topology.coords[index],
+            .position = CURSOR_POS_ON,
+        };
+        if (!g_topology.is_valid[index] || move_cells(board, move, cells) == 0) {
+            continue;
+        }
+        ASSERT(num_moves + 2 <= max_moves);
+        moves[num_moves] = move;
+        moves[num_moves++].clockwise = true;
+        moves[num_moves] = move;
+        moves[num_moves++].clockwise = false;
+    }
+    return num_moves;
+}
+
+bool moves_apply(HexBoard* board, Move move, uint32_t level, MoveOutcome* outcome) {
+    *outcome = (MoveOutcome){ .move = move };
+
+    uint8_t cells[MAX_NUM_HEX_NEIGHBORS];
+    const size_t num_cells = move_cells(board, move, cells);
+    if (num_cells == 0) {
+        return false;
+    }
+
+    // Like handle_rotation(), everything except a starflower rotation is repeated
+    // up to 3 times until something matches.
+    const bool is_starflower_rotation =
+        (move.position == CURSOR_POS_ON) &&
+        (board->cells[HEX_INDEX(move.anchor.q, move.anchor.r)].type == HEX_TYPE_STARFLOWER);
+    const uint32_t max_rotations = is_starflower_rotation ? 1 : 3;
+
+    for (uint32_t rotation = 1; rotation <= max_rotations; rotation++) {
+        rotate_cells(board, cells, num_cells, move.clockwise);
+        outcome->num_rotations = rotation;
+        if (rotated_cells_have_matches(board, cells, num_cells)) {
+            moves_resolve_matches(board, level, outcome);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool moves_evaluate(const HexBoard* board, Move move, uint32_t level, MoveOutcome* outcome) {
+    HexBoard scratch = *board;
+    return moves_apply(&scratch, move, level, outcome);
+}
+
+size_t moves_evaluate_all(const HexBoard* board, uint32_t level, MoveOutcome* outcomes, size_t max_outcomes) {
+    Move moves[MOVES_MAX];
+    const size_t num_moves = moves_generate(board, moves, ARRAY_SIZE(moves));
+    ASSERT(num_moves <= max_outcomes);
+    for (size_t i = 0; i < num_moves; i++) {
+        moves_evaluate(board, moves[i], level, &outcomes[i]);
+    }
+    return num_moves;
+}
+
+// Whether move matches anything, without resolving the matches. The board is restored
+// before returning.
+static bool move_matches(HexBoard* board, Move move) {
+    uint8_t cells[MAX_NUM_HEX_NEIGHBORS];
+    const size_t num_cells = move_cells(board, move, cells);
+    if (num_cells == 0) {
+        return false;
+    }
+
+    // Same repetitions as moves_apply()
+    const bool is_starflower_rotation =
+        (move.position == CURSOR_POS_ON) &&
+        (board->cells[HEX_INDEX(move.anchor.q, move.anchor.r)].type == HEX_TYPE_STARFLOWER);
+    const uint32_t max_rotations = is_starflower_rotation ? 1 : 3;
+
+    bool matched = false;
+    uint32_t num_rotations = 0;
+    while (!matched && num_rotations < max_rotations) {
+        rotate_cells(board, cells, num_cells, move.clockwise);
+        num_rotations++;
+        matched = rotated_cells_have_matches(board, cells, num_cells);
+    }
+    for (uint32_t i = 0; i < num_rotations; i++) {
+        rotate_cells(board, cells, num_cells, !move.clockwise);
+    }
+    return matched;
+}
+
+static Move slot_move(size_t slot) {
+    Move move = { .clockwise = (slot % 2) == 0 };
+    if (slot < 2 * TOPOLOGY_MAX_TRIANGLES) {
+        const TopologyTriangle* triangle = &g_topology.triangles[slot / 2];
+        move.anchor = g_topology.coords[triangle->cells[0]];
+        move.position = (triangle->neighbor_mask == TRIO_LEFT_NEIGHBORS) ? CURSOR_POS_LEFT : CURSOR_POS_RIGHT;
+    } else {
+        move.anchor = g_topology.coords[(slot - 2 * TOPOLOGY_MAX_TRIANGLES) / 2];
+        move.position = CURSOR_POS_ON;
+    }
+    return move;
+}
+
+// A trio rotates the same way from whichever of its cells is the anchor, so every
+// cursor position around a trio shares that trio's slots. Returns -1 for moves that are
+// never legal.
+static int move_slot(Move move) {
+    if (!hex_coord_is_valid(move.anchor)) {
+        return -1;
+    }
+    const int anchor = HEX_INDEX(move.anchor.q, move.anchor.r);
+    const int direction = move.clockwise ? 0 : 1;
+    if (move.position == CURSOR_POS_ON) {
+        return 2 * TOPOLOGY_MAX_TRIANGLES + 2 * anchor + direction;
+    }
+    const uint8_t mask = (move.position == CURSOR_POS_LEFT) ? TRIO_LEFT_NEIGHBORS : TRIO_RIGHT_NEIGHBORS;
+    const uint8_t triangle = g_topology.cell_triangles[anchor][__builtin_ctz(mask)];
+    if (triangle == TOPOLOGY_NO_TRIANGLE) {
+        return -1;
+    }
+    return 2 * triangle + direction;
+}
+
+static bool slot_is_set(const MovesIndex* index, size_t slot) {
+    return (index->matching[slot / 64] >> (slot % 64)) & 1;
+}
+
+static void set_slot(MovesIndex* index, size_t slot, bool matching) {
+    if (matching != slot_is_set(index, slot)) {
+        index->matching[slot / 64] ^= 1ull << (slot % 64);
+        index->num_matching += matching ? 1 : -1;
+    }
+}
+
+// Evaluates both directions of the move in slot, which is clockwise. Rotating three hexes
+// up to three times visits the same two boards in either direction, so only starflowers
+// need both directions evaluated.
+static void evaluate_slots(MovesIndex* index, size_t slot) {
+    const Move move = slot_move(slot);
+    const bool clockwise = move_matches(&index->board, move);
+    set_slot(index, slot, clockwise);
+    index->num_evaluated++;
+
+    const bool is_starflower_rotation =
+        (move.position == CURSOR_POS_ON) &&
+        (index->board.cells[HEX_INDEX(move.anchor.q, move.anchor.r)].type == HEX_TYPE_STARFLOWER);
+    if (is_starflower_rotation) {
+        set_slot(index, slot + 1, move_matches(&index->board, slot_move(slot + 1)));
+        index->num_evaluated++;
+    } else {
+        set_slot(index, slot + 1, clockwise);
+    }
+}
+
+static bool mask_has_index(BitboardMask mask, int index) {
+    return (mask >> index) & 1;
+}
+
+void moves_index_reset(MovesIndex* index) {
+    memset(index, 0, sizeof(*index));
+}
+
+void moves_index_update(MovesIndex* index, const HexBoard* board) {
+    // Cells whose type changed
+    BitboardMask changed = 0;
+    if (!index->is_built) {
+        moves_index_reset(index);
+        for (int i = 0; i < TOPOLOGY_NUM_CELLS; i++) {
+            index->board.cells[i] = (Hex){ .type = HEX_TYPE_INVALID };
+            if (g_topology.is_valid[i]) {
+                index->board.cells[i].is_valid = true;
+                index->board.cells[i].is_stationary = true;
+            }
+        }
+        index->is_built = true;
+    }
+    for (int i = 0; i < HEX_NUM_INDICES; i++) {
+        if (g_topology.is_valid[i] && index->board.cells[i].type != board->cells[i].type) {
+            index->board.cells[i].type = board->cells[i].type;
+            changed |= (BitboardMask)1 << i;
+        }
+    }
+
+    index->num_evaluated = 0;
+    if (changed == 0) {
+        return;
+    }
+
+    // A trio depends on cells within two hexes of it, a starflower or black pearl within
+    // three, since it rotates its neighbors
+    const BitboardMask near_trio = bitboard_dilate(bitboard_dilate(changed));
+    const BitboardMask near_center = bitboard_dilate(near_trio);
+    for (size_t t = 0; t < g_topology.num_triangles; t++) {
+        const uint8_t* cells = g_topology.triangles[t].cells;
+        if (mask_has_index(near_trio, cells[0]) ||
+            mask_has_index(near_trio, cells[1]) ||
+            mask_has_index(near_trio, cells[2])) {
+            evaluate_slots(index, 2 * t);
+        }
+    }
+    for (int i = 0; i < HEX_NUM_INDICES; i++) {
+        if (g_topology.is_valid[i] && mask_has_index(near_center, i)) {
+            evaluate_slots(index, 2 * TOPOLOGY_MAX_TRIANGLES + 2 * i);
+        }
+    }
+}
+
+bool moves_index_any(const MovesIndex* index) {
+    return index->num_matching > 0;
+}
+
+bool moves_index_matches(const MovesIndex* index, Move move) {
+    const int slot = move_slot(move);
+    return slot >= 0 && slot_is_set(index, slot);
+}
+
+bool moves_index_first(const MovesIndex* index, Move* move) {
+    for (size_t w = 0; w < MOVES_INDEX_NUM_WORDS; w++) {
+        if (index->matching[w] != 0) {
+            *move = slot_move(w * 64 + __builtin_ctzll(index->matching[w]));
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,379 @@
+#include "replay.h"
+#include "macros.h"
+#include "log.h"
+#include <string.h>
+
+#define TAG_MAX_KEYS 0x3F
+#define TAG_KEYFRAME 0x40
+#define TAG_END      0x41
+#define TAG_DELTA_KEYFRAME 0x42
+
+static const char REPLAY_MAGIC[4] = { 'H', 'X', 'R', 'P' };
+
+static uint8_t keys_from_input(const Input* input) {
+    uint8_t keys = 0;
+    keys |= input->up ? REPLAY_KEY_UP : 0;
+    keys |= input->down ? REPLAY_KEY_DOWN : 0;
+    keys |= input->left ? REPLAY_KEY_LEFT : 0;
+    keys |= input->right ? REPLAY_KEY_RIGHT : 0;
+    keys |= input->rotate_cw ? REPLAY_KEY_ROTATE_CW : 0;
+    keys |= input->rotate_ccw ? REPLAY_KEY_ROTATE_CCW : 0;
+    return keys;
+}
+
+static void press_keys(Input* input, uint8_t keys) {
+    input->up = (keys & REPLAY_KEY_UP) != 0;
+    input->down = (keys & REPLAY_KEY_DOWN) != 0;
+    input->left = (keys & REPLAY_KEY_LEFT) != 0;
+    input->right = (keys & REPLAY_KEY_RIGHT) != 0;
+    input->rotate_cw = (keys & REPLAY_KEY_ROTATE_CW) != 0;
+    input->rotate_ccw = (keys & REPLAY_KEY_ROTATE_CCW) != 0;
+}
+
+static void restore_keyframe(const GameSnapshot* keyframe, GameState* state) {
+    snapshot_restore(keyframe, state);
+    press_keys(&state->input, 0);
+}
+
+static void write_bytes(ReplayRecorder* recorder, const void* data, size_t size) {
+    if (fwrite(data, 1, size, recorder->file) != size) {
+        LOG("Replay: write failed");
+    }
+    recorder->num_bytes += size;
+}
+
+// Unsigned LEB128
+static void write_varint(ReplayRecorder* recorder, uint32_t value) {
+    uint8_t bytes[5];
+    size_t num_bytes = 0;
+    do {
+        bytes[num_bytes] = value & 0x7F;
+        value >>= 7;
+        if (value) {
+            bytes[num_bytes] |= 0x80;
+        }
+        num_bytes++;
+    } while (value);
+    write_bytes(recorder, bytes, num_bytes);
+}
+
+static void write_record(ReplayRecorder* recorder, uint8_t tag, uint32_t frame) {
+    ASSERT(frame >= recorder->prev_frame);
+    write_bytes(recorder, &tag, 1);
+    write_varint(recorder, frame - recorder->prev_frame);
+    recorder->prev_frame = frame;
+}
+
+// The first keyframe is written whole, the rest as deltas from the one before
+static void write_keyframe(ReplayRecorder* recorder, const GameState* state, bool first) {
+    GameSnapshot keyframe;
+    snapshot_capture(&keyframe, state);
+    if (first) {
+        write_record(recorder, TAG_KEYFRAME, state->frame_count);
+        write_bytes(recorder, &keyframe, sizeof(keyframe));
+    } else {
+        uint8_t delta[SNAPSHOT_DELTA_MAX_SIZE];
+        const size_t delta_size = snapshot_delta_encode(&recorder->prev_keyframe, &keyframe, delta);
+        write_record(recorder, TAG_DELTA_KEYFRAME, state->frame_count);
+        write_varint(recorder, delta_size);
+        write_bytes(recorder, delta, delta_size);
+    }
+    recorder->prev_keyframe = keyframe;
+    fflush(recorder->file);
+}
+
+bool replay_recorder_open(ReplayRecorder* recorder, const char* path, GameState* state, uint32_t keyframe_interval) {
+    memset(recorder, 0, sizeof(*recorder));
+    recorder->file = fopen(path, "wb");
+    if (recorder->file == NULL) {
+        LOG("Replay: can't open %s for writing", path);
+        return false;
+    }
+    recorder->keyframe_interval = MAX(keyframe_interval, 1u);
+    recorder->prev_frame = state->frame_count;
+
+    ReplayHeader header = {
+        .version = REPLAY_VERSION,
+        .keyframe_size = sizeof(GameSnapshot),
+        .seed = state->game.seed,
+        .start_frame = state->frame_count,
+        .keyframe_interval = recorder->keyframe_interval,
+    };
+    memcpy(header.magic, REPLAY_MAGIC, sizeof(header.magic));
+    write_bytes(recorder, &header, sizeof(header));
+    write_keyframe(recorder, state, true);
+    LOG("Replay: recording to %s", path);
+    return true;
+}
+
+void replay_recorder_update(ReplayRecorder* recorder, GameState* state) {
+    if (recorder->file == NULL) {
+        return;
+    }
+    const uint8_t keys = keys_from_input(&state->update_input);
+    if (keys != 0) {
+        write_record(recorder, keys, state->frame_count - 1);
+    }
+    if (state->frame_count % recorder->keyframe_interval == 0) {
+        write_keyframe(recorder, state, false);
+    }
+}
+
+void replay_recorder_close(ReplayRecorder* recorder, const GameState* state) {
+    if (recorder->file == NULL) {
+        return;
+    }
+    write_record(recorder, TAG_END, state->frame_count);
+    fclose(recorder->file);
+    LOG("Replay: recorded %u frames in %llu bytes",
+            state->frame_count, (unsigned long long)recorder->num_bytes);
+    recorder->file = NULL;
+}
+
+static bool read_varint(const uint8_t* data, size_t size, size_t* offset, uint32_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*offset >= size) {
+            return false;
+        }
+        const uint8_t byte = data[(*offset)++];
+        *value |= (uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Parses the records after the header. A truncated last record is dropped.
+static void parse_records(ReplayPlayer* player, const uint8_t* data, size_t size) {
+    size_t offset = sizeof(ReplayHeader);
+    uint32_t frame = player->header.start_frame;
+    while (offset < size) {
+        const uint8_t tag = data[offset++];
+        uint32_t delta = 0;
+        if (!read_varint(data, size, &offset, &delta)) {
+            LOG("Replay: truncated at byte %zu", offset);
+            break;
+        }
+        frame += delta;
+
+        if (tag >= 1 && tag <= TAG_MAX_KEYS) {
+            const ReplayEvent event = { .frame = frame, .keys = tag };
+            vector_push_back(player->events, &event);
+        } else if (tag == TAG_KEYFRAME || tag == TAG_DELTA_KEYFRAME) {
+            const size_t num_keyframes = vector_size(player->keyframes);
+            uint32_t keyframe_size = sizeof(GameSnapshot);
+            if (tag == TAG_DELTA_KEYFRAME && (num_keyframes == 0 || !read_varint(data, size, &offset, &keyframe_size))) {
+                LOG("Replay: bad delta keyframe at frame %u", frame);
+                break;
+            }
+            if (size - offset < keyframe_size) {
+                LOG("Replay: truncated keyframe at frame %u", frame);
+                break;
+            }
+
+            GameSnapshot keyframe;
+            if (tag == TAG_KEYFRAME) {
+                memcpy(&keyframe, &data[offset], sizeof(keyframe));
+            } else {
+                keyframe = *(const GameSnapshot*)vector_data_at(player->keyframes, num_keyframes - 1);
+                if (!snapshot_delta_apply(&keyframe, &data[offset], keyframe_size)) {
+                    LOG("Replay: bad delta keyframe at frame %u", frame);
+                    break;
+                }
+            }
+            offset += keyframe_size;
+            if (keyframe.frame_count != frame) {
+                LOG("Replay: keyframe for frame %u found at frame %u", keyframe.frame_count, frame);
+                break;
+            }
+            vector_push_back(player->keyframes, &keyframe);
+        } else if (tag == TAG_END) {
+            player->end_frame = frame;
+            return;
+        } else {
+            LOG("Replay: unknown record %d at byte %zu", tag, offset - 1);
+            break;
+        }
+        player->end_frame = frame;
+    }
+}
+
+bool replay_player_open(ReplayPlayer* player, const char* path) {
+    memset(player, 0, sizeof(*player));
+
+    FILE* file = fopen(path, "rb");
+    if (file == NULL) {
+        LOG("Replay: can't open %s", path);
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    const long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t* data = (size > 0) ? malloc(size) : NULL;
+    const bool read_ok = data && (fread(data, 1, size, file) == (size_t)size);
+    fclose(file);
+    if (!read_ok || size < sizeof(ReplayHeader)) {
+        LOG("Replay: can't read %s", path);
+        free(data);
+        return false;
+    }
+
+    memcpy(&player->header, data, sizeof(player->header));
+    if (memcmp(player->header.magic, REPLAY_MAGIC, sizeof(REPLAY_MAGIC)) != 0 ||
+        player->header.version != REPLAY_VERSION ||
+        player->header.keyframe_size != sizeof(GameSnapshot)) {
+        LOG("Replay: %s is not a replay from this version of the game", path);
+        free(data);
+        return false;
+    }
+
+    player->events = vector_create(sizeof(ReplayEvent));
+    player->keyframes = vector_create(sizeof(GameSnapshot));
+    parse_records(player, data, size);
+    free(data);
+
+    if (vector_size(player->keyframes) == 0) {
+        LOG("Replay: %s has no keyframes", path);
+        replay_player_close(player);
+        return false;
+    }
+    LOG("Replay: %s, seed %u, frames %u to %u, %zu inputs, %zu keyframes",
+            path,
+            player->header.seed,
+            player->header.start_frame,
+            player->end_frame,
+            vector_size(player->events),
+            vector_size(player->keyframes));
+    return true;
+}
+
+void replay_player_close(ReplayPlayer* player) {
+    if (player->events) {
+        vector_destroy(player->events);
+    }
+    if (player->keyframes) {
+        vector_destroy(player->keyframes);
+    }
+    memset(player, 0, sizeof(*player));
+}
+
+static const GameSnapshot* keyframe_at(const ReplayPlayer* player, size_t index) {
+    return (const GameSnapshot*)vector_data_at(player->keyframes, index);
+}
+
+// Checks the simulated game against a keyframe recorded at the current frame
+static void check_keyframe(ReplayPlayer* player, const GameState* state) {
+    const size_t num_keyframes = vector_size(player->keyframes);
+    while (player->next_keyframe < num_keyframes &&
+           keyframe_at(player, player->next_keyframe)->frame_count < state->frame_count) {
+        player->next_keyframe++;
+    }
+    if (player->next_keyframe == num_keyframes ||
+        keyframe_at(player, player->next_keyframe)->frame_count != state->frame_count) {
+        return;
+    }
+
+    GameSnapshot simulated;
+    snapshot_capture(&simulated, state);
+    if (!snapshot_equal(&simulated, keyframe_at(player, player->next_keyframe))) {
+        LOG("Replay: game differs from the recording at frame %u", state->frame_count);
+        player->num_mismatches++;
+    }
+    player->next_keyframe++;
+}
+
+// First event at or after frame
+static size_t first_event_at(const ReplayPlayer* player, uint32_t frame) {
+    size_t lo = 0;
+    size_t hi = vector_size(player->events);
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        if (((const ReplayEvent*)vector_data_at(player->events, mid))->frame < frame) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+bool replay_player_start(ReplayPlayer* player, GameState* state) {
+    game_deinit(state);
+    state->game = (Game){0};
+    state->frame_count = 0;
+    state->slow_mode_throttle = 0;
+    state->suspend_game = false;
+    state->autoplay = false;
+    press_keys(&state->input, 0);
+    if (!game_init_with_seed(state, player->header.seed)) {
+        return false;
+    }
+
+    // Recorded mid-game, so the seed alone can't rebuild the board
+    if (player->header.start_frame != 0) {
+        restore_keyframe(keyframe_at(player, 0), state);
+    }
+    player->next_event = first_event_at(player, state->frame_count);
+    player->next_keyframe = 0;
+    check_keyframe(player, state);
+    return true;
+}
+
+bool replay_player_seek(ReplayPlayer* player, GameState* state, uint32_t frame) {
+    frame = MAX(frame, player->header.start_frame);
+    frame = MIN(frame, player->end_frame);
+
+    // Last keyframe at or before frame
+    size_t index = 0;
+    while (index + 1 < vector_size(player->keyframes) && keyframe_at(player, index + 1)->frame_count <= frame) {
+        index++;
+    }
+    const GameSnapshot* keyframe = keyframe_at(player, index);
+
+    // Only go back to the keyframe if it's closer than the current frame
+    if (frame < state->frame_count || keyframe->frame_count > state->frame_count) {
+        restore_keyframe(keyframe, state);
+        state->suspend_game = false;
+        player->next_event = first_event_at(player, state->frame_count);
+        player->next_keyframe = index + 1;
+    }
+
+    while (state->frame_count < frame) {
+        if (!replay_player_step(player, state)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool replay_player_step(ReplayPlayer* player, GameState* state) {
+    if (replay_player_done(player, state)) {
+        return false;
+    }
+
+    const ReplayEvent* event = NULL;
+    if (player->next_event < vector_size(player->events)) {
+        event = (const ReplayEvent*)vector_data_at(player->events, player->next_event);
+        if (event->frame != state->frame_count) {
+            event = NULL;
+        }
+    }
+    press_keys(&state->input, event ? event->keys : 0);
+
+    // The keys stay pressed if the game is throttled
+    if (!game_update(state)) {
+        return false;
+    }
+    if (event) {
+        player->next_event++;
+    }
+    state->frame_count++;
+    check_keyframe(player, state);
+    return true;
+}
+
+bool replay_player_done(const ReplayPlayer* player, const GameState* state) {
+    return state->frame_count >= player->end_frame;
+}
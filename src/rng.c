@@ -0,0 +1,84 @@
+#include "rng.h"
+
+static inline uint32_t rotl(uint32_t x, int k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+// Used only to expand seeds, as recommended for the xoshiro family
+static uint64_t splitmix64(uint64_t* state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+void rng_seed(Rng* rng, uint64_t seed) {
+    const uint64_t a = splitmix64(&seed);
+    const uint64_t b = splitmix64(&seed);
+    rng->s[0] = (uint32_t)a;
+    rng->s[1] = (uint32_t)(a >> 32);
+    rng->s[2] = (uint32_t)b;
+    rng->s[3] = (uint32_t)(b >> 32);
+}
+
+uint32_t rng_next(Rng* rng) {
+    uint32_t* s = rng->s;
+    const uint32_t result = rotl(s[1] * 5, 7) * 9;
+    const uint32_t t = s[1] << 9;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl(s[3], 11);
+
+    return result;
+}
+
+uint32_t rng_below(Rng* rng, uint32_t n) {
+    // Lemire's multiply-shift, rejecting the few values that would bias the result
+    uint64_t m = (uint64_t)rng_next(rng) * n;
+    if ((uint32_t)m < n) {
+        const uint32_t threshold = -n % n;
+        while ((uint32_t)m < threshold) {
+            m = (uint64_t)rng_next(rng) * n;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+void rng_fill(Rng* rng, uint32_t* values, size_t count) {
+    // Local copy of the state keeps it in registers across the loop
+    Rng local = *rng;
+    for (size_t i = 0; i < count; i++) {
+        values[i] = rng_next(&local);
+    }
+    *rng = local;
+}
+
+Rng rng_split(Rng* rng) {
+    static const uint32_t JUMP[] = { 0x8764000b, 0xf542d2d3, 0x6fa035c3, 0x77f2db5b };
+
+    const Rng child = *rng;
+
+    // Advance the parent by 2^64 outputs
+    uint32_t s[4] = {0};
+    for (size_t i = 0; i < sizeof(JUMP) / sizeof(JUMP[0]); i++) {
+        for (int b = 0; b < 32; b++) {
+            if (JUMP[i] & (1u << b)) {
+                s[0] ^= rng->s[0];
+                s[1] ^= rng->s[1];
+                s[2] ^= rng->s[2];
+                s[3] ^= rng->s[3];
+            }
+            rng_next(rng);
+        }
+    }
+    rng->s[0] = s[0];
+    rng->s[1] = s[1];
+    rng->s[2] = s[2];
+    rng->s[3] = s[3];
+
+    return child;
+}
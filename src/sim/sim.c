@@ -0,0 +1,579 @@
+// Headless simulation: runs game_update() as fast as possible, with no window,
+// renderer or audio device.
+//
+// Usage: hectic-sim [-n frames] [-s seed] [-a] [-v] [-b games] [-t threads]
+//                   [-r replay] [-p replay [-g frame]] [-S] [-G boards] [-D]
+//   -n  number of frames to simulate per game (default 1000000, or 3600 with -b)
+//   -s  game seed, or the seed of the first game with -b (default 1)
+//   -a  autoplay with the AI instead of random key presses
+//   -v  keep game logging enabled
+//   -b  batch mode: play this many games, seeded seed, seed + 1, ..., spread over
+//       1, 2, 4, ... up to -t threads, and report how throughput scales
+//   -t  maximum number of batch threads (default: number of online cores)
+//   -r  record the game to a replay file
+//   -p  play a replay file instead, checking the game against its keyframes
+//   -g  with -p, seek to this frame first, then play to the end
+//   -S  snapshot the game every frame and report snapshot, restore and delta throughput
+//   -G  generate this many match-free level 1 boards, and compare the throughput of the
+//       one pass generator with spawning random boards and rerolling matches
+//   -D  check that the opening board is dealt from the seed: the same seed deals the
+//       same board, and the next seed a different one
+
+#include "game_state.h"
+#include "constants.h"
+#include "topology.h"
+#include "bitboard.h"
+#include "tween.h"
+#include "bump_allocator.h"
+#include "time_utils.h"
+#include "rng.h"
+#include "ai.h"
+#include "replay.h"
+#include "snapshot.h"
+#include "log.h"
+#include "macros.h"
+#include <pthread.h>
+#include <unistd.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+// Frames between random key presses, about 4 per second
+#define SIM_FRAMES_PER_KEY 15
+
+#define SIM_DEFAULT_FRAMES 1000000
+#define SIM_DEFAULT_BATCH_FRAMES 3600
+#define SIM_MAX_THREADS 256
+#define SIM_BOARDS_PER_CHUNK 4096
+#define SIM_BOARD_SIZE (HEX_NUM_COLUMNS * HEX_NUM_ROWS)
+
+typedef struct {
+    uint64_t frames;
+    uint64_t total_score; // over all games, the same for any number of threads
+    uint32_t num_games;
+    uint32_t num_failed; // stopped by a failed assertion
+} SimTotals;
+
+typedef struct {
+    uint32_t first_seed;
+    uint32_t num_games;
+    uint64_t frames_per_game;
+    atomic_uint next_game;
+} SimBatch;
+
+// Time spent on each snapshot operation, over every frame of a game
+typedef struct {
+    uint64_t num_snapshots;
+    uint64_t capture_ns;
+    uint64_t restore_ns;
+    uint64_t encode_ns;
+    uint64_t apply_ns;
+    uint64_t delta_bytes;
+    uint64_t num_mismatches; // deltas that didn't rebuild the snapshot
+    GameSnapshot prev;
+    GameSnapshot rebuilt; // prev, brought up to date with the deltas
+    uint8_t delta[SNAPSHOT_DELTA_MAX_SIZE];
+} SimSnapshotStats;
+
+typedef struct {
+    SimBatch* batch;
+    pthread_t thread;
+    GameState* state;
+    SimTotals totals;
+} SimWorker;
+
+static void press_random_key(Input* input, Rng* rng) {
+    switch (rng_below(rng, 6)) {
+        case 0: input->up = true; break;
+        case 1: input->down = true; break;
+        case 2: input->left = true; break;
+        case 3: input->right = true; break;
+        case 4: input->rotate_cw = true; break;
+        case 5: input->rotate_ccw = true; break;
+    }
+}
+
+// Snapshots state, encodes it as a delta from the previous frame's snapshot and rebuilds it
+// from that delta. Restoring the snapshot must leave the game unchanged.
+static void snapshot_frame(SimSnapshotStats* stats, GameState* state) {
+    GameSnapshot snapshot;
+    uint64_t start = now_ns();
+    snapshot_capture(&snapshot, state);
+    stats->capture_ns += now_ns() - start;
+
+    start = now_ns();
+    snapshot_restore(&snapshot, state);
+    stats->restore_ns += now_ns() - start;
+
+    if (stats->num_snapshots == 0) {
+        stats->prev = snapshot;
+        stats->rebuilt = snapshot;
+    } else {
+        start = now_ns();
+        const size_t delta_size = snapshot_delta_encode(&stats->prev, &snapshot, stats->delta);
+        stats->encode_ns += now_ns() - start;
+
+        start = now_ns();
+        const bool applied = snapshot_delta_apply(&stats->rebuilt, stats->delta, delta_size);
+        stats->apply_ns += now_ns() - start;
+
+        stats->delta_bytes += delta_size;
+        stats->num_mismatches += (applied && snapshot_equal(&stats->rebuilt, &snapshot)) ? 0 : 1;
+        stats->prev = snapshot;
+    }
+    stats->num_snapshots++;
+}
+
+static void print_snapshot_stats(const SimSnapshotStats* stats) {
+    const double num_snapshots = (double)stats->num_snapshots;
+    const double num_deltas = (double)MAX(stats->num_snapshots, 2u) - 1.0;
+    printf("snapshots: %zu bytes each, %" PRIu64 " taken\n", sizeof(GameSnapshot), stats->num_snapshots);
+    printf("  capture: %12.0f snapshots/sec\n", num_snapshots / ((double)stats->capture_ns / 1e9));
+    printf("  restore: %12.0f snapshots/sec\n", num_snapshots / ((double)stats->restore_ns / 1e9));
+    printf("  delta encode: %7.0f snapshots/sec, %.1f bytes per frame\n",
+            num_deltas / ((double)stats->encode_ns / 1e9),
+            (double)stats->delta_bytes / num_deltas);
+    printf("  delta apply: %8.0f snapshots/sec, %" PRIu64 " mismatches\n",
+            num_deltas / ((double)stats->apply_ns / 1e9),
+            stats->num_mismatches);
+}
+
+// Starts a new game in state and plays it for up to num_frames frames, recording it to
+// record_path if non-NULL, and snapshotting every frame into snapshot_stats if non-NULL.
+// Returns the number of frames played.
+static uint64_t play_game(GameState* state, uint32_t seed, uint64_t num_frames, bool autoplay,
+        const char* record_path, SimSnapshotStats* snapshot_stats) {
+    memset(state, 0, sizeof(*state));
+    if (!game_init_with_seed(state, seed)) {
+        state->suspend_game = true;
+        return 0;
+    }
+    state->autoplay = autoplay;
+
+    ReplayRecorder recorder;
+    if (record_path && !replay_recorder_open(&recorder, record_path, state, REPLAY_DEFAULT_KEYFRAME_INTERVAL)) {
+        fprintf(stderr, "Can't record to %s\n", record_path);
+        record_path = NULL;
+    }
+
+    // The simulated player gets its own stream, jumped past the one the game uses
+    Rng input_rng;
+    rng_seed(&input_rng, seed);
+    rng_split(&input_rng);
+
+    uint64_t frame = 0;
+    for (; frame < num_frames && !state->suspend_game; frame++) {
+        if (autoplay) {
+            ai_autoplay_update(state);
+        } else if (frame % SIM_FRAMES_PER_KEY == 0) {
+            press_random_key(&state->input, &input_rng);
+        }
+        if (game_update(state)) {
+            state->frame_count++;
+            if (record_path) {
+                replay_recorder_update(&recorder, state);
+            }
+            if (snapshot_stats) {
+                snapshot_frame(snapshot_stats, state);
+            }
+        }
+        state->game.pending_sound_effects = 0;
+        bump_allocator_free_all(&state->temporary_allocator);
+    }
+    if (record_path) {
+        replay_recorder_close(&recorder, state);
+    }
+    return frame;
+}
+
+// Plays a replay headless, as fast as possible
+static int main_replay(const char* path, int64_t seek_frame) {
+    static GameState state;
+    ReplayPlayer player;
+    if (!replay_player_open(&player, path) || !replay_player_start(&player, &state)) {
+        fprintf(stderr, "Can't play %s\n", path);
+        return 1;
+    }
+
+    const uint64_t start = now_ns();
+    if (seek_frame >= 0) {
+        replay_player_seek(&player, &state, seek_frame);
+        printf("seeked to frame %u in %.2f ms\n", state.frame_count, (double)(now_ns() - start) / 1e6);
+    }
+    const uint32_t first_frame = state.frame_count;
+    while (replay_player_step(&player, &state)) {
+        state.game.pending_sound_effects = 0;
+        bump_allocator_free_all(&state.temporary_allocator);
+    }
+    const double elapsed_s = (double)(now_ns() - start) / 1e9;
+    const uint32_t frames = state.frame_count - first_frame;
+
+    printf("replay seed %u: %u frames in %.2f s (%.0f frames/sec), score %u, level %u, combos remaining %u, %u keyframe mismatches\n",
+            player.header.seed,
+            frames,
+            elapsed_s,
+            (double)frames / elapsed_s,
+            state.game.score,
+            state.game.level,
+            state.game.combos_remaining,
+            player.num_mismatches);
+
+    const bool ok = replay_player_done(&player, &state) && player.num_mismatches == 0;
+    if (!ok) {
+        fprintf(stderr, "Replay stopped at frame %u of %u\n", state.frame_count, player.end_frame);
+    }
+    replay_player_close(&player);
+    game_deinit(&state);
+    return ok ? 0 : 1;
+}
+
+static void* batch_worker_main(void* arg) {
+    SimWorker* worker = (SimWorker*)arg;
+    SimBatch* batch = worker->batch;
+    while (1) {
+        const uint32_t game = atomic_fetch_add(&batch->next_game, 1);
+        if (game >= batch->num_games) {
+            break;
+        }
+        worker->totals.frames += play_game(
+                worker->state, batch->first_seed + game, batch->frames_per_game, false, NULL, NULL);
+        worker->totals.total_score += worker->state->game.score;
+        worker->totals.num_games++;
+        worker->totals.num_failed += worker->state->suspend_game ? 1 : 0;
+        game_deinit(worker->state);
+    }
+    return NULL;
+}
+
+// Plays the whole batch on num_threads threads. Returns false if threads can't be created.
+static bool run_batch(SimWorker* workers, uint32_t num_threads, SimBatch* batch, SimTotals* totals) {
+    atomic_store(&batch->next_game, 0);
+    for (uint32_t i = 0; i < num_threads; i++) {
+        workers[i].batch = batch;
+        workers[i].totals = (SimTotals){0};
+    }
+
+    // Worker 0 is the calling thread
+    uint32_t num_started = 1;
+    bool ok = true;
+    for (; num_started < num_threads; num_started++) {
+        SimWorker* worker = &workers[num_started];
+        if (pthread_create(&worker->thread, NULL, batch_worker_main, worker) != 0) {
+            ok = false;
+            break;
+        }
+    }
+    batch_worker_main(&workers[0]);
+
+    *totals = (SimTotals){0};
+    for (uint32_t i = 0; i < num_started; i++) {
+        if (i > 0) {
+            pthread_join(workers[i].thread, NULL);
+        }
+        totals->frames += workers[i].totals.frames;
+        totals->total_score += workers[i].totals.total_score;
+        totals->num_games += workers[i].totals.num_games;
+        totals->num_failed += workers[i].totals.num_failed;
+    }
+    return ok;
+}
+
+static int main_batch(uint32_t first_seed, uint32_t num_games, uint64_t frames_per_game, uint32_t max_threads) {
+    SimWorker* workers = calloc(max_threads, sizeof(SimWorker));
+    if (workers == NULL) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    for (uint32_t i = 0; i < max_threads; i++) {
+        workers[i].state = malloc(sizeof(GameState));
+        if (workers[i].state == NULL) {
+            fprintf(stderr, "Out of memory\n");
+            return 1;
+        }
+    }
+
+    SimBatch batch = {
+        .first_seed = first_seed,
+        .num_games = num_games,
+        .frames_per_game = frames_per_game,
+    };
+    printf("Batch: %u games of %" PRIu64 " frames, seeds %u to %u\n",
+            num_games, frames_per_game, first_seed, first_seed + num_games - 1);
+
+    int result = 0;
+    double single_thread_rate = 0.0;
+    uint64_t single_thread_score = 0;
+    for (uint32_t num_threads = 1; ; num_threads = MIN(num_threads * 2, max_threads)) {
+        SimTotals totals;
+        const uint64_t start = now_ns();
+        if (!run_batch(workers, num_threads, &batch, &totals)) {
+            fprintf(stderr, "Failed to start %u threads\n", num_threads);
+            result = 1;
+            break;
+        }
+        const double elapsed_s = (double)(now_ns() - start) / 1e9;
+        const double rate = (double)totals.frames / elapsed_s;
+        if (num_threads == 1) {
+            single_thread_rate = rate;
+            single_thread_score = totals.total_score;
+        }
+
+        printf("  %3u threads: %12.0f frames/sec, %5.2fx speedup, %5.1f%% efficiency, total score %" PRIu64 "%s\n",
+                num_threads,
+                rate,
+                rate / single_thread_rate,
+                rate / single_thread_rate / num_threads * 100.0,
+                totals.total_score,
+                (totals.total_score == single_thread_score) ? "" : " (differs from 1 thread)");
+        if (totals.num_failed > 0) {
+            fprintf(stderr, "%u games stopped by a failed assertion\n", totals.num_failed);
+            result = 1;
+        }
+        if (totals.total_score != single_thread_score) {
+            result = 1;
+        }
+        if (num_threads == max_threads) {
+            break;
+        }
+    }
+
+    for (uint32_t i = 0; i < max_threads; i++) {
+        free(workers[i].state);
+    }
+    free(workers);
+    return result;
+}
+
+// How game_init() used to make a match-free board: spawn random hexes, then reroll
+// matched hexes until there are no matches. Returns the number of rerolls.
+static uint32_t generate_by_rerolling(Game* game, uint32_t mask) {
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        game->columns[q].size = 0;
+    }
+    HexType types[SIM_BOARD_SIZE];
+    hex_random_types(&game->rng, mask, types, ARRAY_SIZE(types));
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        for (int r = 0; r < HEX_NUM_ROWS; r++) {
+            hex_spawn(game, q, types[q * HEX_NUM_ROWS + r]);
+        }
+    }
+
+    uint32_t num_rerolls = 0;
+    while (game_has_any_matches(game, MATCH_KERNEL_BITBOARD, false)) {
+        num_rerolls++;
+        for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+            for (int r = 0; r < HEX_NUM_ROWS; r++) {
+                if (hex_has_cluster_match(game, q, r, NULL, NULL, false)) {
+                    hex_at(game, q, r)->type = hex_random_type_with_mask(&game->rng, mask);
+                }
+            }
+        }
+        for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+            for (int r = 0; r < HEX_NUM_ROWS; r++) {
+                if (hex_has_flower_match(game, q, r, false)) {
+                    hex_at(game, q, r - 1)->type = hex_random_type_with_mask(&game->rng, mask);
+                }
+            }
+        }
+    }
+    return num_rerolls;
+}
+
+// Loads types into the board of game, and checks it has no matches
+static bool board_is_match_free(Game* game, const HexType* types) {
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        game->columns[q].size = 0;
+        for (int r = 0; r < HEX_NUM_ROWS; r++) {
+            hex_spawn(game, q, types[q * HEX_NUM_ROWS + r]);
+        }
+    }
+    return !game_has_any_matches(game, MATCH_KERNEL_REFERENCE, false);
+}
+
+// Generates num_boards boards both ways and reports boards/sec
+static int main_generate(uint32_t seed, uint64_t num_boards) {
+    static GameState state;
+    static HexType boards[SIM_BOARDS_PER_CHUNK * SIM_BOARD_SIZE];
+    if (!game_init_with_seed(&state, seed)) {
+        return 1;
+    }
+    const uint32_t mask = hex_level_type_mask(1);
+    Rng rng;
+    rng_seed(&rng, seed);
+
+    uint64_t generate_ns = 0;
+    uint64_t num_match_free = 0;
+    uint64_t num_verified = 0;
+    for (uint64_t done = 0; done < num_boards; ) {
+        const size_t n = MIN(num_boards - done, (uint64_t)SIM_BOARDS_PER_CHUNK);
+        const uint64_t start = now_ns();
+        num_match_free += hex_random_match_free_boards(&rng, mask, boards, n);
+        generate_ns += now_ns() - start;
+        for (size_t i = 0; i < n; i++) {
+            num_verified += board_is_match_free(&state.game, &boards[i * SIM_BOARD_SIZE]) ? 1 : 0;
+        }
+        done += n;
+    }
+
+    uint64_t num_rerolls = 0;
+    const uint64_t reroll_start = now_ns();
+    for (uint64_t i = 0; i < num_boards; i++) {
+        num_rerolls += generate_by_rerolling(&state.game, mask);
+    }
+    const uint64_t reroll_ns = now_ns() - reroll_start;
+
+    const double generate_rate = (double)num_boards / ((double)generate_ns / 1e9);
+    const double reroll_rate = (double)num_boards / ((double)reroll_ns / 1e9);
+    printf("%" PRIu64 " level 1 boards\n", num_boards);
+    printf("  one pass: %10.0f boards/sec, %" PRIu64 " match-free, %" PRIu64 " verified\n",
+            generate_rate, num_match_free, num_verified);
+    printf("  reroll:   %10.0f boards/sec, %.2f rerolls per board\n",
+            reroll_rate, (double)num_rerolls / (double)num_boards);
+    printf("  speedup:  %10.2fx\n", generate_rate / reroll_rate);
+
+    const bool ok = !state.suspend_game && num_verified == num_boards;
+    game_deinit(&state);
+    return ok ? 0 : 1;
+}
+
+// Copies the types of the opening board of a game seeded seed. Invalid cells are NUM_HEX_TYPES.
+static bool deal_board(GameState* state, uint32_t seed, HexType* types) {
+    if (!game_init_with_seed(state, seed)) {
+        return false;
+    }
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        for (int r = 0; r < HEX_NUM_ROWS; r++) {
+            const Hex* hex = hex_at(&state->game, q, r);
+            types[q * HEX_NUM_ROWS + r] = hex->is_valid ? hex->type : NUM_HEX_TYPES;
+        }
+    }
+    game_deinit(state);
+    return true;
+}
+
+static int main_check_deal(uint32_t seed) {
+    static GameState state;
+    HexType first[SIM_BOARD_SIZE];
+    HexType again[SIM_BOARD_SIZE];
+    HexType next[SIM_BOARD_SIZE];
+    if (!deal_board(&state, seed, first) ||
+        !deal_board(&state, seed, again) ||
+        !deal_board(&state, seed + 1, next)) {
+        return 1;
+    }
+    const bool same_seed_same_board = memcmp(first, again, sizeof(first)) == 0;
+    const bool next_seed_new_board = memcmp(first, next, sizeof(first)) != 0;
+    printf("seed %u deals the same board again: %s\n", seed, same_seed_same_board ? "yes" : "NO");
+    printf("seed %u deals a different board: %s\n", seed + 1, next_seed_new_board ? "yes" : "NO");
+    return (same_seed_same_board && next_seed_new_board) ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    uint64_t num_frames = 0;
+    uint32_t seed = 1;
+    bool autoplay = false;
+    bool verbose = false;
+    uint32_t num_games = 0;
+    long max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char* record_path = NULL;
+    const char* play_path = NULL;
+    int64_t seek_frame = -1;
+    bool snapshots = false;
+    uint64_t num_boards = 0;
+    bool check_deal = false;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            num_frames = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) {
+            seed = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-a") == 0) {
+            autoplay = true;
+        } else if (strcmp(argv[i], "-v") == 0) {
+            verbose = true;
+        } else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) {
+            num_games = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc) {
+            max_threads = strtol(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) {
+            record_path = argv[++i];
+        } else if (strcmp(argv[i], "-p") == 0 && i + 1 < argc) {
+            play_path = argv[++i];
+        } else if (strcmp(argv[i], "-g") == 0 && i + 1 < argc) {
+            seek_frame = strtoll(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-S") == 0) {
+            snapshots = true;
+        } else if (strcmp(argv[i], "-G") == 0 && i + 1 < argc) {
+            num_boards = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "-D") == 0) {
+            check_deal = true;
+        } else {
+            fprintf(stderr, "Usage: %s [-n frames] [-s seed] [-a] [-v] [-b games] [-t threads] "
+                    "[-r replay] [-p replay [-g frame]] [-S] [-G boards] [-D]\n", argv[0]);
+            return 1;
+        }
+    }
+    log_set_enabled(verbose);
+
+    if (!constants_init() ||
+        !topology_init() ||
+        !bitboard_init() ||
+        !tween_init() ||
+        (autoplay && !ai_init(seed))) {
+        fprintf(stderr, "Initialization failed\n");
+        return 1;
+    }
+
+    if (play_path) {
+        return main_replay(play_path, seek_frame);
+    }
+    if (num_boards > 0) {
+        return main_generate(seed, num_boards);
+    }
+    if (check_deal) {
+        return main_check_deal(seed);
+    }
+
+    if (num_games > 0) {
+        // The AI searches one board at a time with all of its threads
+        if (autoplay) {
+            fprintf(stderr, "Autoplay (-a) can't be used in batch mode (-b)\n");
+            ai_close();
+            return 1;
+        }
+        max_threads = MAX(1, MIN(max_threads, SIM_MAX_THREADS));
+        return main_batch(seed, num_games, num_frames ? num_frames : SIM_DEFAULT_BATCH_FRAMES, max_threads);
+    }
+
+    static GameState state;
+    static SimSnapshotStats snapshot_stats;
+    const uint64_t start = now_ns();
+    const uint64_t frames = play_game(&state, seed, num_frames ? num_frames : SIM_DEFAULT_FRAMES, autoplay,
+            record_path, snapshots ? &snapshot_stats : NULL);
+    const double elapsed_s = (double)(now_ns() - start) / 1e9;
+
+    printf("seed %u: %" PRIu64 " frames in %.2f s (%.0f frames/min), score %u, level %u, combos remaining %u, "
+            "reshuffles %u\n",
+            seed,
+            frames,
+            elapsed_s,
+            (double)frames / elapsed_s * 60.0,
+            state.game.score,
+            state.game.level,
+            state.game.combos_remaining,
+            state.num_reshuffles);
+    if (snapshots) {
+        print_snapshot_stats(&snapshot_stats);
+    }
+
+    if (autoplay) {
+        ai_close();
+    }
+    if (state.suspend_game) {
+        fprintf(stderr, "Stopped by a failed assertion at frame %" PRIu64 "\n", frames);
+        return 1;
+    }
+    game_deinit(&state);
+    return 0;
+}
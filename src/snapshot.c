@@ -0,0 +1,185 @@
+#include "snapshot.h"
+#include "macros.h"
+#include <string.h>
+
+#define SNAPSHOT_NUM_WORDS (sizeof(GameSnapshot) / sizeof(uint64_t))
+#define SNAPSHOT_SCAN_WORDS 8
+
+_Static_assert(sizeof(GameSnapshot) % sizeof(uint64_t) == 0, "snapshot deltas work on whole words");
+
+void snapshot_capture(GameSnapshot* snapshot, const GameState* state) {
+    snapshot->frame_count = state->frame_count;
+    snapshot->cursor = state->cursor;
+    snapshot->game = state->game;
+}
+
+void snapshot_restore(const GameSnapshot* snapshot, GameState* state) {
+    state->frame_count = snapshot->frame_count;
+    state->cursor = snapshot->cursor;
+    state->game = snapshot->game;
+    moves_index_reset(&state->moves_index);
+}
+
+bool snapshot_equal(const GameSnapshot* a, const GameSnapshot* b) {
+    const Game* ga = &a->game;
+    const Game* gb = &b->game;
+    if (a->frame_count != b->frame_count ||
+        memcmp(ga->rng.s, gb->rng.s, sizeof(ga->rng.s)) != 0 ||
+        ga->score != gb->score ||
+        ga->level != gb->level ||
+        ga->combos_remaining != gb->combos_remaining ||
+        ga->dirty_cells != gb->dirty_cells ||
+        ga->falling_columns != gb->falling_columns ||
+        ga->num_falling_hexes != gb->num_falling_hexes ||
+        ga->num_animating_hexes != gb->num_animating_hexes ||
+        ga->next_landing_time != gb->next_landing_time ||
+        ga->gravity != gb->gravity ||
+        ga->rotation_animation.in_progress != gb->rotation_animation.in_progress ||
+        ga->rotation_animation.start_time != gb->rotation_animation.start_time ||
+        ga->rotation_animation.rotation_count != gb->rotation_animation.rotation_count ||
+        ga->rotation_animation.rotation_center.x != gb->rotation_animation.rotation_center.x ||
+        ga->rotation_animation.rotation_center.y != gb->rotation_animation.rotation_center.y ||
+        ga->rotation_animation.is_trio_rotation != gb->rotation_animation.is_trio_rotation ||
+        ga->rotation_animation.degrees_to_rotate != gb->rotation_animation.degrees_to_rotate ||
+        a->cursor.hex_anchor.q != b->cursor.hex_anchor.q ||
+        a->cursor.hex_anchor.r != b->cursor.hex_anchor.r ||
+        a->cursor.position != b->cursor.position) {
+        return false;
+    }
+
+    for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
+        const HexColumn* ca = &ga->columns[q];
+        const HexColumn* cb = &gb->columns[q];
+        if (ca->size != cb->size) {
+            return false;
+        }
+        for (size_t i = 0; i < ca->size; i++) {
+            const Hex* ha = &ca->hexes[i];
+            const Hex* hb = &cb->hexes[i];
+            const HexMotion* ma = &ca->motion[i];
+            const HexMotion* mb = &cb->motion[i];
+            const HexAnimation* aa = &ca->animations[i];
+            const HexAnimation* ab = &cb->animations[i];
+            if (ha->type != hb->type ||
+                ha->is_valid != hb->is_valid ||
+                ha->is_dead != hb->is_dead ||
+                ha->is_stationary != hb->is_stationary ||
+                ha->is_rotating != hb->is_rotating ||
+                ha->is_matched != hb->is_matched ||
+                ha->is_flower_matched != hb->is_flower_matched ||
+                ma->fall_start_y != mb->fall_start_y ||
+                ma->gravity != mb->gravity ||
+                ma->gravity_start_time != mb->gravity_start_time ||
+                ma->landing_time != mb->landing_time ||
+                aa->match_animation != ab->match_animation) {
+                return false;
+            }
+        }
+    }
+
+    // Tweens time the match animations
+    const TweenPool* pa = &ga->tweens;
+    const TweenPool* pb = &gb->tweens;
+    if (pa->size != pb->size) {
+        return false;
+    }
+    for (uint32_t i = 0; i < pa->size; i++) {
+        const Tween* ta = &pa->tweens[i];
+        const Tween* tb = &pb->tweens[i];
+        if (ta->start_time != tb->start_time ||
+            ta->duration != tb->duration ||
+            ta->target != tb->target ||
+            ta->done != tb->done ||
+            ta->q != tb->q ||
+            ta->index != tb->index) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static uint64_t load_word(const void* snapshot, size_t index) {
+    uint64_t word;
+    memcpy(&word, (const uint8_t*)snapshot + index * sizeof(word), sizeof(word));
+    return word;
+}
+
+// Unsigned LEB128
+static size_t write_varint(uint8_t* out, size_t value) {
+    size_t num_bytes = 0;
+    do {
+        out[num_bytes] = value & 0x7F;
+        value >>= 7;
+        if (value) {
+            out[num_bytes] |= 0x80;
+        }
+        num_bytes++;
+    } while (value);
+    return num_bytes;
+}
+
+static bool read_varint(const uint8_t* data, size_t size, size_t* offset, size_t* value) {
+    *value = 0;
+    for (int shift = 0; shift < 35; shift += 7) {
+        if (*offset >= size) {
+            return false;
+        }
+        const uint8_t byte = data[(*offset)++];
+        *value |= (size_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t snapshot_delta_encode(const GameSnapshot* base, const GameSnapshot* snapshot, uint8_t* delta) {
+    size_t size = 0;
+    size_t run_end = 0; // word after the previous run
+    size_t i = 0;
+    while (i < SNAPSHOT_NUM_WORDS) {
+        // Most of the snapshot is unchanged, so skip over it a block at a time
+        if (i + SNAPSHOT_SCAN_WORDS <= SNAPSHOT_NUM_WORDS &&
+            memcmp((const uint64_t*)base + i, (const uint64_t*)snapshot + i, SNAPSHOT_SCAN_WORDS * sizeof(uint64_t)) == 0) {
+            i += SNAPSHOT_SCAN_WORDS;
+            continue;
+        }
+        if (load_word(base, i) == load_word(snapshot, i)) {
+            i++;
+            continue;
+        }
+        const size_t run_start = i;
+        while (i < SNAPSHOT_NUM_WORDS && load_word(base, i) != load_word(snapshot, i)) {
+            i++;
+        }
+        size += write_varint(&delta[size], run_start - run_end);
+        size += write_varint(&delta[size], i - run_start);
+        const size_t num_bytes = (i - run_start) * sizeof(uint64_t);
+        memcpy(&delta[size], (const uint8_t*)snapshot + run_start * sizeof(uint64_t), num_bytes);
+        size += num_bytes;
+        run_end = i;
+    }
+    ASSERT(size <= SNAPSHOT_DELTA_MAX_SIZE);
+    return size;
+}
+
+bool snapshot_delta_apply(GameSnapshot* snapshot, const uint8_t* delta, size_t size) {
+    size_t offset = 0;
+    size_t word = 0;
+    while (offset < size) {
+        size_t skip = 0;
+        size_t num_words = 0;
+        if (!read_varint(delta, size, &offset, &skip) || !read_varint(delta, size, &offset, &num_words)) {
+            return false;
+        }
+        word += skip;
+        const size_t num_bytes = num_words * sizeof(uint64_t);
+        if (word > SNAPSHOT_NUM_WORDS || num_words > SNAPSHOT_NUM_WORDS - word || num_bytes > size - offset) {
+            return false;
+        }
+        memcpy((uint8_t*)snapshot + word * sizeof(uint64_t), &delta[offset], num_bytes);
+        offset += num_bytes;
+        word += num_words;
+    }
+    return true;
+}
@@ -0,0 +1,113 @@
+#include "sprite_batch.h"
+#include <math.h>
+
+void sprite_batch_init(SpriteBatch* batch) {
+    batch->texture = NULL;
+    batch->num_sprites = 0;
+#ifdef USE_RENDER_GEOMETRY
+    // Two triangles per quad, corners clockwise from the top left
+    for (int i = 0; i < SPRITE_BATCH_MAX_SPRITES; i++) {
+        int* indices = &batch->indices[i * 6];
+        const int corner = i * 4;
+        indices[0] = corner;
+        indices[1] = corner + 1;
+        indices[2] = corner + 2;
+        indices[3] = corner;
+        indices[4] = corner + 2;
+        indices[5] = corner + 3;
+    }
+#endif
+}
+
+void sprite_batch_flush(SpriteBatch* batch) {
+    if (batch->num_sprites == 0) {
+        return;
+    }
+#ifdef USE_RENDER_GEOMETRY
+    if (0 != SDL_RenderGeometry(
+                window_renderer(),
+                batch->texture,
+                batch->vertices,
+                batch->num_sprites * 4,
+                batch->indices,
+                batch->num_sprites * 6)) {
+        SDL_Log("SDL_RenderGeometry error %s", SDL_GetError());
+    }
+#endif
+    batch->num_sprites = 0;
+}
+
+#ifdef USE_RENDER_GEOMETRY
+void sprite_batch_add(
+        SpriteBatch* batch,
+        SDL_Texture* texture,
+        const SDL_Rect* src,
+        const SDL_FRect* dest,
+        double angle,
+        SDL_FPoint center,
+        Uint8 alpha) {
+    if (texture != batch->texture || batch->num_sprites == SPRITE_BATCH_MAX_SPRITES) {
+        sprite_batch_flush(batch);
+    }
+    if (texture != batch->texture) {
+        batch->texture = texture;
+        SDL_QueryTexture(texture, NULL, NULL, &batch->texture_width, &batch->texture_height);
+    }
+
+    // Corners relative to the center of rotation, rotated as by SDL_RenderCopyEx()
+    float c = 1.0f;
+    float s = 0.0f;
+    if (angle != 0.0) {
+        const float radians = (float)(angle * M_PI / 180.0);
+        c = cosf(radians);
+        s = sinf(radians);
+    }
+    const SDL_FPoint pivot = { dest->x + center.x, dest->y + center.y };
+    const float left = -center.x;
+    const float top = -center.y;
+    const float right = left + dest->w;
+    const float bottom = top + dest->h;
+    const SDL_FPoint corners[4] = {
+        { left, top },
+        { right, top },
+        { right, bottom },
+        { left, bottom },
+    };
+
+    const float u0 = (float)src->x / batch->texture_width;
+    const float v0 = (float)src->y / batch->texture_height;
+    const float u1 = (float)(src->x + src->w) / batch->texture_width;
+    const float v1 = (float)(src->y + src->h) / batch->texture_height;
+    const SDL_FPoint tex_coords[4] = {
+        { u0, v0 },
+        { u1, v0 },
+        { u1, v1 },
+        { u0, v1 },
+    };
+
+    const SDL_Color color = { .r = 0xFF, .g = 0xFF, .b = 0xFF, .a = alpha };
+    SDL_Vertex* vertices = &batch->vertices[batch->num_sprites * 4];
+    for (int i = 0; i < 4; i++) {
+        vertices[i].position.x = pivot.x + c * corners[i].x - s * corners[i].y;
+        vertices[i].position.y = pivot.y + s * corners[i].x + c * corners[i].y;
+        vertices[i].color = color;
+        vertices[i].tex_coord = tex_coords[i];
+    }
+    batch->num_sprites++;
+}
+#else
+void sprite_batch_add(
+        SpriteBatch* batch,
+        SDL_Texture* texture,
+        const SDL_Rect* src,
+        const SDL_FRect* dest,
+        double angle,
+        SDL_FPoint center,
+        Uint8 alpha) {
+    SDL_Rect dest_rect = { .x = dest->x, .y = dest->y, .w = dest->w, .h = dest->h };
+    SDL_Point center_point = { .x = center.x, .y = center.y };
+    SDL_SetTextureAlphaMod(texture, alpha);
+    SDL_RenderCopyEx(window_renderer(), texture, src, &dest_rect, angle, &center_point, SDL_FLIP_NONE);
+    SDL_SetTextureAlphaMod(texture, 0xFF);
+}
+#endif
@@ -9,6 +9,13 @@ void statistics_update(uint64_t update_time_ns, uint64_t render_time_ns, uint64_
     _statistics.loop_iter_ave_ns = (_statistics.loop_iter_ave_ns * smoothing) + ((double)loop_iter_time_ns * (1.0f - smoothing));
 }
 
+void statistics_update_match_cells(uint32_t cells_examined) {
+    const double smoothing = 0.9f;
+    _statistics.match_cells_last = cells_examined;
+    _statistics.match_cells_total += cells_examined;
+    _statistics.match_cells_ave = (_statistics.match_cells_ave * smoothing) + ((double)cells_examined * (1.0f - smoothing));
+}
+
 double statistics_fps(void) {
     return 1000000000.0f / _statistics.loop_iter_ave_ns;
 }
@@ -1,5 +1,5 @@
 #include "test_boards.h"
-#include "game_state.h"
+#include "game.h"
 #include <stdio.h>
 
 #define GR HEX_TYPE_GREEN
@@ -50,11 +50,11 @@ static const char* type_to_str[NUM_HEX_TYPES] = {
     [HEX_TYPE_BLACK_PEARL_DOWN] = "BD",
 };
 
-void test_boards_print_current(void) {
+void test_boards_print_current(Game* game) {
     printf("\n\n");
     for (int r = 0; r < HEX_NUM_ROWS; r++) {
         for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-            const Hex* hex = hex_at(q,r);
+            const Hex* hex = hex_at(game, q, r);
             if (hex->is_valid && hex->type < NUM_HEX_TYPES) {
                 printf("%s, ", type_to_str[hex->type]);
             } else {
@@ -66,10 +66,10 @@ void test_boards_print_current(void) {
     printf("\n");
 }
 
-void test_boards_load(HexType board[BOARD_SIZE]) {
+void test_boards_load(Game* game, HexType board[BOARD_SIZE]) {
     for (int r = 0; r < HEX_NUM_ROWS; r++) {
         for (int q = 0; q < HEX_NUM_COLUMNS; q++) {
-            Hex* hex = hex_at(q,r);
+            Hex* hex = hex_at(game, q, r);
             if (hex->is_valid) {
                 hex->type = board[r * HEX_NUM_COLUMNS + q];
             }
@@ -8,5 +8,5 @@
 extern HexType g_test_board_yellow_starflower[BOARD_SIZE];
 extern HexType g_test_board_six_black_pearls[BOARD_SIZE];
 
-void test_boards_print_current(void);
-void test_boards_load(HexType board[BOARD_SIZE]);
+void test_boards_print_current(Game* game);
+void test_boards_load(Game* game, HexType board[BOARD_SIZE]);
@@ -0,0 +1,93 @@
+#include "topology.h"
+#include "macros.h"
+#include <string.h>
+
+Topology g_topology = {0};
+
+static int cell_index(HexCoord coord) {
+    return hex_coord_is_valid(coord) ? HEX_INDEX(coord.q, coord.r) : TOPOLOGY_SENTINEL;
+}
+
+static void add_triangle(int anchor, uint8_t neighbor_mask) {
+    HexNeighbors neighbors = {0};
+    const HexCoord c = g_topology.coords[anchor];
+    hex_neighbors(c.q, c.r, &neighbors, neighbor_mask);
+    ASSERT(neighbors.num_neighbors == 2);
+
+    const int n1 = cell_index(neighbors.coords[0]);
+    const int n2 = cell_index(neighbors.coords[1]);
+    if (n1 == TOPOLOGY_SENTINEL || n2 == TOPOLOGY_SENTINEL) {
+        return;
+    }
+
+    ASSERT(g_topology.num_triangles < TOPOLOGY_MAX_TRIANGLES);
+    g_topology.triangles[g_topology.num_triangles++] = (TopologyTriangle){
+        .cells = { anchor, n1, n2 },
+        .neighbor_mask = neighbor_mask,
+    };
+}
+
+static bool triangle_contains(const TopologyTriangle* triangle, int cell) {
+    return
+        triangle->cells[0] == cell ||
+        triangle->cells[1] == cell ||
+        triangle->cells[2] == cell;
+}
+
+bool topology_init(void) {
+    memset(&g_topology, 0, sizeof(g_topology));
+
+    for (int index = 0; index < TOPOLOGY_NUM_CELLS; index++) {
+        HexCoord c = hex_index_to_coord(index);
+        g_topology.coords[index] = c;
+        g_topology.is_valid[index] = (index != TOPOLOGY_SENTINEL) && hex_coord_is_valid(c);
+        for (int id = 0; id < MAX_NUM_HEX_NEIGHBORS; id++) {
+            g_topology.neighbors[index][id] = TOPOLOGY_SENTINEL;
+            g_topology.cell_triangles[index][id] = TOPOLOGY_NO_TRIANGLE;
+        }
+    }
+
+    for (int index = 0; index < HEX_NUM_INDICES; index++) {
+        if (!g_topology.is_valid[index]) {
+            continue;
+        }
+        HexCoord c = g_topology.coords[index];
+        bool all_neighbors_valid = true;
+        for (int id = 0; id < MAX_NUM_HEX_NEIGHBORS; id++) {
+            int n = cell_index(hex_neighbor_coord(c.q, c.r, id));
+            g_topology.neighbors[index][id] = n;
+            all_neighbors_valid &= (n != TOPOLOGY_SENTINEL);
+        }
+        if (all_neighbors_valid) {
+            g_topology.flower_centers[g_topology.num_flower_centers++] = index;
+        }
+
+        // Each trio has exactly one hex to the left or right of the other two
+        add_triangle(index, TRIO_RIGHT_NEIGHBORS);
+        add_triangle(index, TRIO_LEFT_NEIGHBORS);
+    }
+
+    // Index triangles by cell and neighbor pair
+    for (int index = 0; index < HEX_NUM_INDICES; index++) {
+        const uint8_t* neighbors = g_topology.neighbors[index];
+        for (int i = 0; i < MAX_NUM_HEX_NEIGHBORS; i++) {
+            const int n1 = neighbors[i];
+            const int n2 = neighbors[(i + 1) % MAX_NUM_HEX_NEIGHBORS];
+            if (!g_topology.is_valid[index] || n1 == TOPOLOGY_SENTINEL || n2 == TOPOLOGY_SENTINEL) {
+                continue;
+            }
+            for (size_t t = 0; t < g_topology.num_triangles; t++) {
+                const TopologyTriangle* triangle = &g_topology.triangles[t];
+                if (triangle_contains(triangle, index) &&
+                    triangle_contains(triangle, n1) &&
+                    triangle_contains(triangle, n2)) {
+                    g_topology.cell_triangles[index][i] = t;
+                    break;
+                }
+            }
+            ASSERT(g_topology.cell_triangles[index][i] != TOPOLOGY_NO_TRIANGLE);
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,126 @@
+#include "tween.h"
+#include "game.h"
+#include "macros.h"
+
+// Each curve maps progress [0, 1] to [0, 1], sampled at TWEEN_EASING_TABLE_SIZE + 1
+// evenly spaced points
+static float _easing_tables[NUM_TWEEN_EASINGS][TWEEN_EASING_TABLE_SIZE + 1];
+
+static double ease(int easing, double t) {
+    switch (easing) {
+    case TWEEN_EASING_LINEAR:
+        return t;
+    case TWEEN_EASING_QUADRATIC_IN:
+        return t * t;
+    case TWEEN_EASING_PULSE:
+        return (t < 0.5) ? (t / 0.5) : (1.0 - (t - 0.5) / 0.5);
+    }
+    return t;
+}
+
+bool tween_init(void) {
+    for (int easing = 0; easing < NUM_TWEEN_EASINGS; easing++) {
+        for (int i = 0; i <= TWEEN_EASING_TABLE_SIZE; i++) {
+            _easing_tables[easing][i] = (float)ease(easing, (double)i / TWEEN_EASING_TABLE_SIZE);
+        }
+    }
+    return true;
+}
+
+static bool tween_is_on_hex(const Tween* tween) {
+    return tween->target <= TWEEN_TARGET_HEX_ROTATION_ANGLE;
+}
+
+// The hex a hex tween targets. Its transformations are saved on the first write of each
+// frame, so they can be drawn part way between frames.
+static HexAnimation* tweened_hex(Game* game, const Tween* tween, uint32_t now) {
+    HexAnimation* animation = &game->columns[tween->q].animations[tween->index];
+    if (animation->tween_frame != now) {
+        animation->tween_frame = now;
+        animation->prev_scale = animation->scale;
+        animation->prev_rotation_angle = animation->rotation_angle;
+    }
+    return animation;
+}
+
+static void remove_at(TweenPool* pool, uint32_t i) {
+    pool->tweens[i] = pool->tweens[--pool->size];
+}
+
+void tween_pool_clear(TweenPool* pool) {
+    pool->size = 0;
+}
+
+void tween_pool_add(TweenPool* pool, const Tween* tween) {
+    ASSERT(pool->size < TWEEN_POOL_SIZE);
+    ASSERT(tween->duration > 0);
+    pool->tweens[pool->size++] = *tween;
+}
+
+uint32_t tween_pool_update(Game* game, uint32_t now, Tween* finished) {
+    TweenPool* pool = &game->tweens;
+    uint32_t num_finished = 0;
+    uint32_t i = 0;
+    while (i < pool->size) {
+        const Tween* tween = &pool->tweens[i];
+        const int32_t elapsed = (int32_t)(now - tween->start_time);
+        if (elapsed < 0) {
+            i++;
+            continue;
+        }
+        if (elapsed > tween->duration) {
+            if (tween->done != TWEEN_DONE_NONE) {
+                finished[num_finished++] = *tween;
+            }
+            // Swap in the last tween, and look at this slot again
+            remove_at(pool, i);
+            continue;
+        }
+
+        const float position = (float)elapsed * TWEEN_EASING_TABLE_SIZE / tween->duration;
+        const int sample = MIN((int)position, TWEEN_EASING_TABLE_SIZE - 1);
+        const float* table = _easing_tables[tween->easing];
+        const float fraction = position - sample;
+        const float t = table[sample] + (table[sample + 1] - table[sample]) * fraction;
+        const double value = tween->from + (tween->to - tween->from) * t;
+
+        switch (tween->target) {
+        case TWEEN_TARGET_HEX_TIMER:
+            break;
+        case TWEEN_TARGET_HEX_SCALE:
+            tweened_hex(game, tween, now)->scale = value;
+            break;
+        case TWEEN_TARGET_HEX_ALPHA:
+            tweened_hex(game, tween, now)->alpha = value;
+            break;
+        case TWEEN_TARGET_HEX_ROTATION_ANGLE:
+            tweened_hex(game, tween, now)->rotation_angle = value;
+            break;
+        case TWEEN_TARGET_LOCAL_SCORE_ALPHA:
+            game->local_score_animations[tween->index].alpha = value;
+            break;
+        case TWEEN_TARGET_LOCAL_SCORE_Y:
+            game->local_score_animations[tween->index].current_point.y = value;
+            break;
+        }
+        i++;
+    }
+    return num_finished;
+}
+
+void tween_pool_erase(TweenPool* pool, int q, uint32_t erased) {
+    uint32_t i = 0;
+    while (i < pool->size) {
+        Tween* tween = &pool->tweens[i];
+        if (!tween_is_on_hex(tween) || tween->q != q) {
+            i++;
+            continue;
+        }
+        if (erased & (1u << tween->index)) {
+            remove_at(pool, i);
+            continue;
+        }
+        tween->index -= __builtin_popcount(erased & ((1u << tween->index) - 1));
+        i++;
+    }
+}
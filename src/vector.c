@@ -20,17 +20,14 @@
 // WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
 
 #include "vector.h"
-#include "bump_allocator.h"
 
 #include <string.h>
 #include <stdint.h>
 #include <macros.h>
-#include <SDL.h>
+#include "log.h"
 
 // First allocation will be at least this many bytes
 #define FIRST_ALLOC_MIN_BYTES 32
-#define DEFAULT_ALLOC_FN malloc
-#define DEFAULT_FREE_FN free
 
 struct _Vector {
     // Max number of items the vector can currently hold (will be resized as needed).
@@ -44,18 +41,27 @@ struct _Vector {
     // Allocator
     AllocFn alloc_fn;
     FreeFn free_fn;
+    void* allocator;
 };
 
+static void* default_alloc(void* allocator, size_t size) {
+    return malloc(size);
+}
+
+static void default_free(void* allocator, void* ptr) {
+    free(ptr);
+}
+
 
 static int resize(Vector v, size_t new_capacity) {
-    void* new_data = v->alloc_fn(v->item_size * new_capacity);
+    void* new_data = v->alloc_fn(v->allocator, v->item_size * new_capacity);
     if (new_data == NULL) {
         return -1;
     }
 
     if (v->size > 0) {
         memcpy(new_data, v->data, v->size * v->item_size);
-        v->free_fn(v->data);
+        v->free_fn(v->allocator, v->data);
     }
     v->data = new_data;
     v->capacity = new_capacity;
@@ -63,14 +69,15 @@ static int resize(Vector v, size_t new_capacity) {
 }
 
 Vector vector_create(size_t item_size) {
-    return vector_create_with_allocator(item_size, DEFAULT_ALLOC_FN, DEFAULT_FREE_FN);
+    return vector_create_with_allocator(item_size, default_alloc, default_free, NULL);
 }
 
-Vector vector_create_with_allocator(size_t item_size, AllocFn alloc_fn, FreeFn free_fn) {
-    Vector instance = alloc_fn(sizeof(struct _Vector));
+Vector vector_create_with_allocator(size_t item_size, AllocFn alloc_fn, FreeFn free_fn, void* allocator) {
+    Vector instance = alloc_fn(allocator, sizeof(struct _Vector));
     if (instance) {
         instance->alloc_fn = alloc_fn;
         instance->free_fn = free_fn;
+        instance->allocator = allocator;
         instance->capacity = 0;
         instance->size = 0;
         instance->item_size = item_size;
@@ -81,14 +88,15 @@ Vector vector_create_with_allocator(size_t item_size, AllocFn alloc_fn, FreeFn f
 }
 
 Vector vector_clone(Vector src) {
-    Vector instance = src->alloc_fn(sizeof(struct _Vector));
+    Vector instance = src->alloc_fn(src->allocator, sizeof(struct _Vector));
     if (instance) {
         instance->alloc_fn = src->alloc_fn;
         instance->free_fn = src->free_fn;
+        instance->allocator = src->allocator;
         instance->capacity = src->capacity;
         instance->size = src->size;
         instance->item_size = src->item_size;
-        instance->data = src->alloc_fn(src->capacity * src->item_size);
+        instance->data = src->alloc_fn(src->allocator, src->capacity * src->item_size);
         memcpy(instance->data, src->data, src->size * src->item_size);
     }
     return instance;
@@ -203,39 +211,34 @@ void vector_clear(Vector v) {
 
 void vector_print(Vector v, VectorPrintFn fn) {
     char item_print_buffer[80];
-    SDL_Log("Vector size %zu", vector_size(v));
+    LOG("Vector size %zu", vector_size(v));
     for (size_t i = 0; i < vector_size(v); i++) {
         fn(vector_data_at(v, i), item_print_buffer, sizeof(item_print_buffer));
         item_print_buffer[sizeof(item_print_buffer) - 1] = 0;
-        SDL_Log("   [%zu]: %s\n", i, item_print_buffer);
+        LOG("   [%zu]: %s\n", i, item_print_buffer);
     }
 }
 
 void vector_erase_if(Vector v, VectorEraseFn erase_fn) {
-    Vector temp = vector_create_with_allocator(
-            v->item_size, bump_allocator_alloc, bump_allocator_free);
-    vector_reserve(temp, v->capacity);
-
-    // Copy non-erased items to a new vector
-    for (size_t i = 0; i < vector_size(v); i++) {
-        const void* item = vector_data_at(v, i);
-        if (!erase_fn(item)) {
-            vector_push_back(temp, item);
+    // Stable in-place compaction: move each kept item down to the next free slot
+    uint8_t* data = (uint8_t*)v->data;
+    size_t new_size = 0;
+    for (size_t i = 0; i < v->size; i++) {
+        const uint8_t* item = data + i * v->item_size;
+        if (erase_fn(item)) {
+            continue;
         }
+        if (new_size != i) {
+            memcpy(data + new_size * v->item_size, item, v->item_size);
+        }
+        new_size++;
     }
-    ASSERT(temp->size <= v->size);
-
-    v->size = temp->size;
-    if (temp->size > 0) {
-        memcpy(v->data, temp->data, temp->item_size * temp->size);
-    }
-
-    vector_destroy(temp);
+    v->size = new_size;
 }
 
 void vector_destroy(Vector v) {
     if (v->data) {
-        v->free_fn(v->data);
+        v->free_fn(v->allocator, v->data);
     }
-    v->free_fn(v);
+    v->free_fn(v->allocator, v);
 }